@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../bitboard.h"
+#include "../game.h"
+#include "../board.h"
+#include "../move.h"
+#include "../race.h"
+#include "../strategy/minimax.h"
+#include "positions.h"
+
+// Microbenchmarks for the Board hot paths. Every benchmark runs over the whole position corpus;
+// a sample is one timed batch of passes and results are reported in nanoseconds per operation.
+//
+// Usage: phantomracer_bench [--out FILE] [--compare FILE] [--samples N] [--filter TEXT]
+
+struct BenchPosition {
+    Board board;
+    PieceRange range;
+    MoveList whiteMoves;
+    MoveList blackMoves;
+};
+
+struct BenchResult {
+    std::string name;
+    u64 opsPerPass;
+    double minNs;
+    double p10Ns;
+    double medianNs;
+    double p90Ns;
+    double maxNs;
+};
+
+static volatile u64 benchSink = 0;
+
+static std::vector<BenchPosition> loadCorpus() {
+    std::vector<BenchPosition> corpus;
+
+    for (auto text : BENCH_POSITIONS) {
+        Board board;
+        PieceRange range;
+        if (!parseBoard(text, board, range)) {
+            std::cerr << "Invalid bench position: " << text << std::endl;
+            continue;
+        }
+        corpus.push_back(BenchPosition{board, range,
+                                       board.getValidMoves(PieceRange::White),
+                                       board.getValidMoves(PieceRange::Black)});
+    }
+
+    return corpus;
+}
+
+static double percentile(const std::vector<double> &sorted, double fraction) {
+    auto idx = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// Runs one pass of `pass` repeatedly: first to pick a batch size that takes about a millisecond,
+// then to warm up, then `samples` timed batches.
+static BenchResult runBench(const std::string &name, u64 opsPerPass, int samples, const std::function<u64()> &pass) {
+    using Clock = std::chrono::steady_clock;
+
+    auto timeBatch = [&](u64 passes) {
+        u64 sink = 0;
+        auto start = Clock::now();
+        for (u64 i = 0; i < passes; i++) {
+            sink += pass();
+        }
+        auto end = Clock::now();
+        benchSink = benchSink + sink;
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    };
+
+    u64 passes = 1;
+    while (timeBatch(passes) < 1e6 && passes < (C64(1) << 30)) {
+        passes *= 2;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        timeBatch(passes);
+    }
+
+    std::vector<double> perOp;
+    perOp.reserve(samples);
+    for (int i = 0; i < samples; i++) {
+        perOp.push_back(timeBatch(passes) / static_cast<double>(passes * opsPerPass));
+    }
+    std::sort(perOp.begin(), perOp.end());
+
+    return BenchResult{name, opsPerPass, perOp.front(), percentile(perOp, 0.1), percentile(perOp, 0.5),
+                       percentile(perOp, 0.9), perOp.back()};
+}
+
+static std::vector<BenchResult> runAll(const std::vector<BenchPosition> &corpus, int samples, const std::string &filter) {
+    std::vector<BenchResult> results;
+
+    auto add = [&](const std::string &name, u64 opsPerPass, const std::function<u64()> &pass) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        results.push_back(runBench(name, opsPerPass, samples, pass));
+    };
+
+    u64 positions = corpus.size();
+    u64 whiteMoveCount = 0, blackMoveCount = 0, occupiedCount = 0;
+    for (const auto &position : corpus) {
+        whiteMoveCount += position.whiteMoves.moves.size();
+        blackMoveCount += position.blackMoves.moves.size();
+        occupiedCount += __builtin_popcountll(position.board.allPieces);
+    }
+
+    add("getValidMoves/white", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.getValidMoves<PieceRange::White>().moves.size();
+        return sum;
+    });
+
+    add("getValidMoves/black", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.getValidMoves<PieceRange::Black>().moves.size();
+        return sum;
+    });
+
+    add("getCaptureMoves/white", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.getCaptureMoves<PieceRange::White>().moves.size();
+        return sum;
+    });
+
+    add("getCaptureMoves/black", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.getCaptureMoves<PieceRange::Black>().moves.size();
+        return sum;
+    });
+
+    add("countMoves/white", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.countMoves<PieceRange::White>();
+        return sum;
+    });
+
+    add("countMoves/black", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += position.board.countMoves<PieceRange::Black>();
+        return sum;
+    });
+
+    // Each operation copies the position and applies one move to the copy, as search does.
+    add("performMove/white", whiteMoveCount, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            for (auto move : position.whiteMoves.moves) {
+                Board boardCopy(position.board);
+                boardCopy.performMove<PieceRange::White>(move);
+                sum += boardCopy.allPieces;
+            }
+        }
+        return sum;
+    });
+
+    add("performMove/black", blackMoveCount, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            for (auto move : position.blackMoves.moves) {
+                Board boardCopy(position.board);
+                boardCopy.performMove<PieceRange::Black>(move);
+                sum += boardCopy.allPieces;
+            }
+        }
+        return sum;
+    });
+
+    add("hash", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum ^= position.board.hash();
+        return sum;
+    });
+
+    add("heuristic", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) sum += static_cast<u64>(heuristic(position.board));
+        return sum;
+    });
+
+    add("resolveRace", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            auto race = position.range == PieceRange::White? resolveRace<PieceRange::White>(position.board)
+                                                           : resolveRace<PieceRange::Black>(position.board);
+            sum += race.tempo;
+        }
+        return sum;
+    });
+
+    add("copy", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            Board boardCopy(position.board);
+            sum += boardCopy.allPieces;
+        }
+        return sum;
+    });
+
+    // One operation is all eight directions from one occupied square.
+    add("rayAttacks", occupiedCount, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            const Board &board = position.board;
+            u64 occupied = board.allPieces;
+            while (occupied) {
+                auto square = static_cast<u8>(__builtin_ctzll(occupied));
+                u64 friendly = (board.sidePieces<PieceRange::White>() & pieceLookupTable[square])
+                               ? board.sidePieces<PieceRange::White>() : board.sidePieces<PieceRange::Black>();
+                sum += board.getPositiveRayAttacks(friendly, North, square)
+                     ^ board.getPositiveRayAttacks(friendly, NorthWest, square)
+                     ^ board.getPositiveRayAttacks(friendly, NorthEast, square)
+                     ^ board.getPositiveRayAttacks(friendly, East, square)
+                     ^ board.getNegativeRayAttacks(friendly, South, square)
+                     ^ board.getNegativeRayAttacks(friendly, SouthWest, square)
+                     ^ board.getNegativeRayAttacks(friendly, SouthEast, square)
+                     ^ board.getNegativeRayAttacks(friendly, West, square);
+                occupied &= occupied - 1;
+            }
+        }
+        return sum;
+    });
+
+    // The neural evaluation, with random weights since only its speed is measured. A search keeps the
+    // accumulators along its line in its context, so that is where they are set up and updated here.
+    u64 seed = 1;
+    for (auto &column : nnueNetwork.featureWeights) {
+        for (auto &weight : column) weight = static_cast<int16_t>(splitMix64(seed) % 64) - 32;
+    }
+    for (auto &weight : nnueNetwork.outputWeights) weight = static_cast<int8_t>(splitMix64(seed) % 256 - 128);
+    nnueLoaded = true;
+
+    std::vector<NnueAccumulator> accumulators(corpus.size());
+    for (size_t i = 0; i < corpus.size(); i++) accumulators[i].refresh(corpus[i].board.pieces);
+
+    add("nnue/evaluate", positions, [&]() {
+        u64 sum = 0;
+        for (const auto &accumulator : accumulators) sum += static_cast<u64>(nnueEvaluate(accumulator));
+        return sum;
+    });
+
+    auto context = std::make_unique<SearchContext>();
+    add("nnue/performMove", whiteMoveCount, [&]() {
+        u64 sum = 0;
+        for (const auto &position : corpus) {
+            context->nnueRoot(position.board);
+            for (auto move : position.whiteMoves.moves) {
+                Board boardCopy(position.board);
+                boardCopy.performMove<PieceRange::White>(move);
+                context->nnuePush(position.board, move);
+                sum += boardCopy.allPieces + static_cast<u64>(context->nnueStack[context->nnuePly].values[0]);
+                context->nnuePop();
+            }
+        }
+        return sum;
+    });
+
+    nnueLoaded = false;
+    return results;
+}
+
+// Output is tab-separated with a header line so that two runs can be diffed or fed back via --compare.
+static void writeResults(std::ostream &stream, const std::vector<BenchResult> &results) {
+    stream << "name\tops\tmin_ns\tp10_ns\tmedian_ns\tp90_ns\tmax_ns" << '\n';
+    stream << std::fixed << std::setprecision(3);
+    for (const auto &result : results) {
+        stream << result.name << '\t' << result.opsPerPass << '\t'
+               << result.minNs << '\t' << result.p10Ns << '\t' << result.medianNs << '\t'
+               << result.p90Ns << '\t' << result.maxNs << '\n';
+    }
+}
+
+static std::map<std::string, double> readMedians(const std::string &path) {
+    std::map<std::string, double> medians;
+    std::ifstream file(path);
+    std::string line;
+
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        double ops, minNs, p10Ns, medianNs;
+        if (fields >> name >> ops >> minNs >> p10Ns >> medianNs) {
+            medians[name] = medianNs;
+        }
+    }
+
+    return medians;
+}
+
+int main(int argc, char** argv) {
+    std::string outPath = "bench_results.tsv";
+    std::string comparePath;
+    std::string filter;
+    int samples = 30;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--compare") && i + 1 < argc) {
+            comparePath = argv[++i];
+        } else if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+            samples = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--out FILE] [--compare FILE] [--samples N] [--filter TEXT]" << std::endl;
+            return 1;
+        }
+    }
+
+    initAll();
+
+    auto corpus = loadCorpus();
+    std::cout << "Corpus: " << corpus.size() << " positions, " << samples << " samples per benchmark" << std::endl;
+
+    auto results = runAll(corpus, samples, filter);
+    auto baseline = comparePath.empty()? std::map<std::string, double>() : readMedians(comparePath);
+
+    std::cout << std::left << std::setw(24) << "benchmark"
+              << std::right << std::setw(12) << "median ns" << std::setw(12) << "p10" << std::setw(12) << "p90";
+    if (!baseline.empty()) std::cout << std::setw(12) << "baseline" << std::setw(10) << "change";
+    std::cout << std::endl;
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto &result : results) {
+        std::cout << std::left << std::setw(24) << result.name << std::right
+                  << std::setw(12) << result.medianNs << std::setw(12) << result.p10Ns << std::setw(12) << result.p90Ns;
+
+        auto previous = baseline.find(result.name);
+        if (previous != baseline.end()) {
+            double change = (result.medianNs / previous->second - 1.0) * 100.0;
+            std::cout << std::setw(12) << previous->second << std::setw(9) << std::showpos << change << '%' << std::noshowpos;
+        }
+        std::cout << std::endl;
+    }
+
+    std::ofstream out(outPath);
+    if (!out) {
+        std::cerr << "Could not write " << outPath << std::endl;
+        return 1;
+    }
+    writeResults(out, results);
+    std::cout << "Results written to " << outPath << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../bitboard.h"
+#include "../game.h"
+#include "../board.h"
+#include "../move.h"
+#include "../rng.h"
+#include "../strategy/search.h"
+#include "../strategy/mcts.h"
+
+// Plays the strategies against each other with the same time per move, to compare how strong their
+// moves are per CPU-second. Every pairing plays both colours from the same randomised openings.
+//
+// Usage: phantomracer_match [--players LIST] [--games N] [--ms N] [--opening-plies N] [--seed N]
+// where LIST is comma-separated from minimax, mcts and hybridD (MCTS with depth D leaf searches, e.g.
+// hybrid2); every pair in the list plays N games.
+
+struct Player {
+    std::string name;
+    std::function<Move(const Board&, PieceRange, std::chrono::milliseconds)> chooseMove;
+};
+
+static bool makePlayer(const std::string &name, Player &player) {
+    player.name = name;
+
+    if (name == "minimax") {
+        player.chooseMove = [](const Board &board, PieceRange range, std::chrono::milliseconds budget) {
+            SearchContext context;
+            context.verbose = false;
+            context.setDeadline(std::chrono::steady_clock::now() + budget);
+            transpositionTable.newSearch();
+
+            auto moves = board.getValidMoves(range);
+            SearchResult result = range == PieceRange::Black? searchRoot<PieceRange::Black>(context, board, moves)
+                                                             : searchRoot<PieceRange::White>(context, board, moves);
+            return result.bestMove;
+        };
+        return true;
+    }
+
+    MctsSettings settings;
+    settings.verbose = false;
+    if (name == "mcts") {
+        settings.leafDepth = 0;
+    } else if (name.compare(0, 6, "hybrid") == 0 && name.size() > 6) {
+        settings.leafDepth = atoi(name.c_str() + 6);
+        if (settings.leafDepth < 1) return false;
+    } else {
+        return false;
+    }
+
+    player.chooseMove = [settings](const Board &board, PieceRange range, std::chrono::milliseconds budget) {
+        MctsSettings moveSettings(settings);
+        moveSettings.budget = budget;
+        return searchMcts(board, range, moveSettings);
+    };
+    return true;
+}
+
+// Plays one game and returns the winner's side
+static PieceRange playGame(const Player &black, const Player &white, const Board &opening, PieceRange toMove,
+                           std::chrono::milliseconds budget) {
+    Board board(opening);
+
+    // The players share the transposition table, so neither may learn from what the other stored
+    transpositionTable.clear();
+    while (board.getGameState() == GameState::IsPlaying) {
+        const Player &player = toMove == PieceRange::Black? black : white;
+        board.performMove(toMove, player.chooseMove(board, toMove, budget));
+        toMove = opponentOf(toMove);
+        transpositionTable.clear();
+    }
+
+    return board.getGameState() == GameState::BlackWins? PieceRange::Black : PieceRange::White;
+}
+
+int main(int argc, char** argv) {
+    std::string playerList = "minimax,mcts,hybrid2";
+    int games = 20;
+    int budgetMs = 100;
+    int openingPlies = 2;
+    u64 seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--players") && i + 1 < argc) {
+            playerList = argv[++i];
+        } else if (!strcmp(argv[i], "--games") && i + 1 < argc) {
+            games = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--ms") && i + 1 < argc) {
+            budgetMs = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--opening-plies") && i + 1 < argc) {
+            openingPlies = std::max(0, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--players LIST] [--games N] [--ms N] [--opening-plies N] [--seed N]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Player> players;
+    std::stringstream names(playerList);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        Player player;
+        if (!makePlayer(name, player)) {
+            std::cerr << "Unknown player: " << name << std::endl;
+            return 1;
+        }
+        players.push_back(player);
+    }
+    if (players.size() < 2) {
+        std::cerr << "Need at least two players" << std::endl;
+        return 1;
+    }
+
+    initAll();
+    auto budget = std::chrono::milliseconds(budgetMs);
+    std::cout << games << " games per pairing, " << budgetMs << "ms per move" << std::endl;
+
+    for (size_t a = 0; a < players.size(); a++) {
+        for (size_t b = a + 1; b < players.size(); b++) {
+            int winsA = 0;
+            for (int game = 0; game < games; game++) {
+                // Each opening is played twice, once with each player as black
+                Rng openingRng(seed + game / 2);
+                Board opening;
+                PieceRange toMove = PieceRange::White;
+                for (int ply = 0; ply < openingPlies && opening.getGameState() == GameState::IsPlaying; ply++) {
+                    auto moves = opening.getValidMoves(toMove);
+                    opening.performMove(toMove, moves[openingRng.below(static_cast<uint32_t>(moves.size()))]);
+                    toMove = opponentOf(toMove);
+                }
+
+                // Both games of an opening also share the seed for the players' random choices
+                seedRandom(openingRng.next());
+
+                bool aIsBlack = game % 2 == 0;
+                PieceRange winner = aIsBlack? playGame(players[a], players[b], opening, toMove, budget)
+                                            : playGame(players[b], players[a], opening, toMove, budget);
+                if ((winner == PieceRange::Black) == aIsBlack) winsA++;
+            }
+
+            std::cout << std::left << std::setw(10) << players[a].name << " vs " << std::setw(10) << players[b].name
+                      << std::right << std::setw(4) << winsA << " - " << games - winsA
+                      << std::fixed << std::setprecision(1) << "  (" << 100.0 * winsA / games << "%)" << std::endl;
+        }
+    }
+
+    return 0;
+}
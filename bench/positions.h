@@ -0,0 +1,63 @@
+#pragma once
+
+// Positions sampled every sixth ply from eight engine self-play games (alphabeta at depth 3 with
+// one move in five played at random). Written in the boardToString() notation from board.h.
+static const char* const BENCH_POSITIONS[] = {
+        "C....../.P...../RRPBB../Nb.PPPP/nn.pppp/rrp.b../.p...../c...... b",
+        "C....../.P...../RR..B../Nr.PPpP/n..p.pp/r.p.b../......./c...... b",
+        "C....../.P...../.R..p../N..Pp.P/.....pp/r.p.b../......./cR..... b",
+        "C....../rP...../.b..p../...Pp.p/..N..P./..p..../.R...../cR..... b",
+        "C...p../rP...../.R...../...PN.p/......./..p..P./.c...../.R..... b",
+        "C...p../.r....p/......./...P.../..N..../.Rp..../.c...P./.R..... b",
+        "C...p.p/......./......./.p...../..NP.../......./.c...P./.R..... b",
+        ".p..p.p/......./..C..../......./..NP.../......./.c...../.R...P. b",
+        ".p..p.p/......./......./....C../....c../......./.N...../.R...P. b",
+        "C....../.P...../RRP.B../NN.PPPP/nB.pppp/rrpbb../.p...../c...... w",
+        "C....../.P...../Rn..B../.bPPPPP/.p.Nppp/r...b../.p...../c...... w",
+        "C....../.P...../.n..B../..PPPpP/.p...pp/RpN.b../.c...../....... w",
+        "C....../.P...../.n.bp../......./.p.PPPp/RpN..../.c...../....... w",
+        "......./.C.nb../.P..p../.p...../....PPp/RpNP.../.c...../....... w",
+        "......./....b../.n..p.p/.p..C../....PP./RpNP.../.c...../....... w",
+        "C....../.P...../RRPBB../NN.P.PP/nn.Pppp/rrpbb../.p...../c...... w",
+        "C....../.P...../RnPBB../...P.PP/.R.pppp/rNpbb../......./c...... w",
+        "C....../.P...../.RP.B../...P.PP/...pppp/.rBbb../.c...../....... w",
+        "C....../.P...../.RP.B../..r...p/...p..P/...Pb../.c...../....... w",
+        "C....../......./..P.B../..Pp..p/.R.c..P/...Pb../......./....... w",
+        ".....b./.C...../....B../...P..p/....c.P/...P.../.R...../....... w",
+        ".....bp/.C...../....B../...P.../....c../......P/.R...../...P... w",
+        "C....../.P...../Rn..B../pP..PPP/...pPpp/rr..b../.p...../c...... b",
+        "C....../.P...../Rn...../p...pP./.r..PPp/.r..b../.p...../c...... b",
+        "C....../.P...../Rn..p../p....p./....r../.r...../.p...../c...P.. b",
+        "C....../......./.P..p../p....p./.R..r../.p...../.c...../....P.. b",
+        "......./......./..C.p../P....p./.r.c.../.p...../......./....P.. b",
+        "C....../.P...../nRPBB../NN.PPPP/n..pppp/rrpbb../.p...../c...... b",
+        "C.B..../......./P.PB.../.N.PPPP/...pppp/.rpbb../.p...../c...... b",
+        "C.B..../......./P.PB.../.N.P.../.r.pPPp/.p.bb../......./c...... b",
+        "..B..../.C...../P.P..../.b.P.../.B.pPPp/.pc.b../......./....... b",
+        "..B..../......./P.C...p/.P.P.../...pPb./Bpc..../......./....... b",
+        "......./......p/P.CbB../.P.P.../.p.pP../..c..../......./B...... b",
+        ".b....p/......./P.C..../.P.P.B./.p.p.../..c..../....P../B...... b",
+        ".b....p/p....../..C..../...P.B./.P.p.../..c..../......./B...P.. b",
+        "pb....p/......./..C..../...P.../....c../......./.P...../BB..P.. b",
+        "C....../.P...../RRPBB../NN.PpPP/nn..ppp/rrpbb../.p...../c...... b",
+        "C....../.P...../R.PBB../N..bpPP/nR..ppp/.r..b../.p...../c...... b",
+        "C....../......./RPP.b../....pPP/nB..ppp/....b../.p...../c...... b",
+        "C....../......./.PP.b../....p.P/R...Ppp/.pb..../......./c...... b",
+        "C....../......./.PP..../....p.p/.p....p/..b..../b...P../c...... b",
+        "C....../......./....p../.PP...p/.p....p/......./bc...../....b.. b",
+        "......./......./..C.p../.P.b..p/.P.c..p/......./......./....b.. b",
+        "......./......./..C.p.p/.P.b..p/....c../......./......./.P..b.. b",
+        "C....../.P...../R.P.B../pr.P.PP/n..ppPp/r...b../.p...../c...... b",
+        "C....../......./.pP.B../.r.P..P/R..pPPp/rp..b../.c...../....... b",
+        "C....../.p...../....B../...P..P/.p.pP.p/R...P../.c...../....... b",
+        "C....../.p...../.p...../...P..P/...pP.B/R.c..../......./....P.. b",
+        "Cp...../.p...../......./...P..P/...c.../....P../R...B../....P.. b",
+        "C....../.P...../R...B../p..PPPP/P..pppp/rR..b../.p...../c...... w",
+        "......./......./RPC.p../p..Pp.P/P....pp/rR..b../.p...../c...... w",
+        "......./..b..../R.C.p../p...p../P..P.Pp/p....../......./c...... w",
+        ".b...../......./....p../R..Cp.p/P..P.../p....P./.c...../....... w",
+        ".b...../....p.p/......./R..Cp../P....../p..P.../.c...../.....P. w",
+        ".b...../....p.p/......./R...C../P...c../p....../......./...P.P. w",
+};
+
+static const size_t BENCH_POSITION_COUNT = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "../board.h"
+#include "../strategy/search.h"
+#include "positions.h"
+
+// End-to-end search benchmark: every position in the bench corpus searched to a fixed depth, one thread,
+// on a freshly cleared table of the default size. The total node count is a signature of what the search
+// does and only changes when its behaviour does; the time and nodes per second measure its speed.
+//
+// Usage: phantomracer bench [DEPTH]
+
+#define BENCH_DEPTH 8
+
+int runSearchBench(int depth) {
+    if (transpositionTable.isPersistent()) {
+        std::cerr << "The bench needs the default in-memory transposition table" << std::endl;
+        return 1;
+    }
+
+    u64 totalNodes = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    int index = 0;
+    for (auto text : BENCH_POSITIONS) {
+        Board board;
+        PieceRange range;
+        if (!parseBoard(text, board, range) || board.getGameState() != GameState::IsPlaying) continue;
+
+        transpositionTable.clear();
+        transpositionTable.newSearch();
+        SearchContext context;
+        context.verbose = false;
+
+        auto moves = board.getValidMoves(range);
+        SearchResult result = range == PieceRange::Black? searchRoot<PieceRange::Black>(context, board, moves, depth)
+                                                         : searchRoot<PieceRange::White>(context, board, moves, depth);
+        totalNodes += context.nodesEvaluated;
+
+        std::cout << "Position " << std::setw(2) << ++index << ": " << result.bestMove
+                  << std::setw(10) << result.score << std::setw(12) << context.nodesEvaluated << " nodes" << std::endl;
+    }
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Depth          : " << depth << std::endl;
+    std::cout << "Table entries  : " << transpositionTable.size() << std::endl;
+    std::cout << "Total time (ms): " << elapsedMs << std::endl;
+    std::cout << "Nodes searched : " << totalNodes << std::endl;
+    std::cout << "Nodes/second   : " << totalNodes * 1000 / std::max<long long>(elapsedMs, 1) << std::endl;
+    return 0;
+}
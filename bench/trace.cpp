@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../move.h"
+#include "../trace.h"
+
+// Summarises a search trace written by `phantomracer --trace FILE` (see trace.h): how the nodes of each
+// search were shared between its root moves, how well each ply's move ordering produced cutoffs, and,
+// with --flame, the nodes per line of play as folded stacks ("frame;frame;frame count" per line) for
+// flamegraph.pl or speedscope. Frames deeper than --flame-depth plies are folded into their ancestor.
+//
+// Usage: phantomracer_trace FILE [--flame OUT] [--flame-depth N] [--top N]
+
+struct RootMoveShare {
+    std::string move;
+    u64 nodes = 0;
+    u64 simulations = 0;
+};
+
+struct SearchSummary {
+    bool mcts = false;
+    int depth = 0;              // Deepest completed iteration
+    std::string bestMove;
+    int score = 0;
+    u64 nodes = 0;
+    u64 simulations = 0;
+    std::map<std::string, RootMoveShare> rootMoves;
+};
+
+struct PlyStats {
+    u64 nodes = 0;              // Nodes that searched their moves
+    u64 cutoffs = 0;
+    u64 firstMoveCutoffs = 0;
+    u64 cutoffIndexSum = 0;
+};
+
+static std::string moveName(const TraceRecord &record) {
+    std::stringstream stream;
+    stream << record.move();
+    return stream.str();
+}
+
+// Builds folded stacks from the records of one search, which come after those of their children
+class FlameFolder {
+public:
+    explicit FlameFolder(int maxDepth) : maxDepth(maxDepth), pending(256), pendingNodes(256, 0) {}
+
+    std::map<std::string, u64> lines;
+
+    void startSearch(const std::string &name) {
+        searchName = name;
+        for (auto &level : pending) level.clear();
+        std::fill(pendingNodes.begin(), pendingNodes.end(), 0);
+    }
+
+    void node(const TraceRecord &record) {
+        int ply = record.ply;
+        if (ply == 0 || ply > maxDepth || ply >= 255) return;
+
+        // Whatever is pending one ply down was searched below this node
+        std::string name = moveName(record);
+        u64 childNodes = pendingNodes[ply + 1];
+        for (const auto &line : pending[ply + 1]) pending[ply][name + ';' + line.first] += line.second;
+        pending[ply][name] += record.nodes > childNodes? record.nodes - childNodes : 0;
+        pendingNodes[ply] += record.nodes;
+
+        pending[ply + 1].clear();
+        pendingNodes[ply + 1] = 0;
+    }
+
+    void iteration(const TraceRecord &record) {
+        std::string prefix = searchName + ";depth " + std::to_string(record.depth);
+        for (const auto &line : pending[1]) lines[prefix + ';' + line.first] += line.second;
+        if (record.nodes > pendingNodes[1]) lines[prefix] += record.nodes - pendingNodes[1];
+
+        pending[1].clear();
+        pendingNodes[1] = 0;
+    }
+
+    void simulation(const TraceRecord &record) {
+        // One sample per simulation, so the graph shows where MCTS spent its simulations
+        lines[searchName + ';' + (record.ply > 0? moveName(record) : "root")] += 1;
+    }
+
+private:
+    int maxDepth;
+    std::string searchName;
+    std::vector<std::map<std::string, u64>> pending;
+    std::vector<u64> pendingNodes;
+};
+
+int main(int argc, char** argv) {
+    const char* tracePath = nullptr;
+    const char* flamePath = nullptr;
+    int flameDepth = 6;
+    size_t top = 8;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--flame") && i + 1 < argc) {
+            flamePath = argv[++i];
+        } else if (!strcmp(argv[i], "--flame-depth") && i + 1 < argc) {
+            flameDepth = std::max(1, std::min(200, atoi(argv[++i])));
+        } else if (!strcmp(argv[i], "--top") && i + 1 < argc) {
+            top = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        } else if (!tracePath && argv[i][0] != '-') {
+            tracePath = argv[i];
+        } else {
+            tracePath = nullptr;
+            break;
+        }
+    }
+    if (!tracePath) {
+        std::cerr << "Usage: " << argv[0] << " FILE [--flame OUT] [--flame-depth N] [--top N]" << std::endl;
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    if (!readTrace(tracePath, records)) {
+        std::cerr << "Not a search trace: " << tracePath << std::endl;
+        return 1;
+    }
+
+    std::vector<SearchSummary> searches;
+    std::vector<PlyStats> plies;
+    FlameFolder folder(flameDepth);
+
+    for (const auto &record : records) {
+        if (record.kind == TraceKind::Search || searches.empty()) {
+            searches.emplace_back();
+            folder.startSearch("search " + std::to_string(searches.size()));
+            if (record.kind == TraceKind::Search) continue;
+        }
+        SearchSummary &search = searches.back();
+
+        switch (record.kind) {
+            case TraceKind::Node: {
+                if (record.ply >= plies.size()) plies.resize(record.ply + 1);
+                PlyStats &stats = plies[record.ply];
+                stats.nodes++;
+                if (record.cutoff != TRACE_NO_CUTOFF) {
+                    stats.cutoffs++;
+                    stats.firstMoveCutoffs += record.cutoff == 0;
+                    stats.cutoffIndexSum += record.cutoff;
+                }
+
+                if (record.ply == 1) {
+                    RootMoveShare &share = search.rootMoves[moveName(record)];
+                    share.move = moveName(record);
+                    share.nodes += record.nodes;
+                }
+                folder.node(record);
+                break;
+            }
+            case TraceKind::Iteration:
+                search.nodes += record.nodes;
+                if (record.completed) {
+                    search.depth = record.depth;
+                    search.bestMove = moveName(record);
+                    search.score = record.score;
+                }
+                folder.iteration(record);
+                break;
+            case TraceKind::Simulation: {
+                search.mcts = true;
+                search.simulations++;
+                search.nodes += record.nodes;
+                std::string move = record.ply > 0? moveName(record) : "root";
+                RootMoveShare &share = search.rootMoves[move];
+                share.move = move;
+                share.nodes += record.nodes;
+                share.simulations++;
+                folder.simulation(record);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    std::cout << records.size() << " records, " << searches.size() << " searches" << std::endl;
+
+    for (size_t i = 0; i < searches.size(); i++) {
+        const SearchSummary &search = searches[i];
+        std::cout << std::endl << "Search " << i + 1 << ": ";
+        if (search.mcts) {
+            std::cout << search.simulations << " simulations, " << search.nodes << " leaf search nodes" << std::endl;
+        } else {
+            std::cout << "depth " << search.depth << ", best " << search.bestMove << " (" << search.score << "), "
+                      << search.nodes << " nodes" << std::endl;
+        }
+
+        std::vector<RootMoveShare> shares;
+        for (const auto &entry : search.rootMoves) shares.push_back(entry.second);
+        std::sort(shares.begin(), shares.end(), [&](const RootMoveShare &a, const RootMoveShare &b) {
+            return search.mcts? a.simulations > b.simulations : a.nodes > b.nodes;
+        });
+
+        for (size_t j = 0; j < std::min(top, shares.size()); j++) {
+            u64 count = search.mcts? shares[j].simulations : shares[j].nodes;
+            u64 total = search.mcts? search.simulations : search.nodes;
+            std::cout << "  " << std::left << std::setw(6) << shares[j].move << std::right << std::setw(12) << count
+                      << std::fixed << std::setprecision(1) << std::setw(7) << 100.0 * count / std::max<u64>(total, 1) << "%"
+                      << std::endl;
+        }
+        if (shares.size() > top) std::cout << "  ... " << shares.size() - top << " more" << std::endl;
+    }
+
+    if (!plies.empty()) {
+        // A node cut off by its first move was ordered as well as it could be
+        std::cout << std::endl << " Ply       Nodes     Cutoffs  Cut%  First%  AvgIndex" << std::endl;
+        for (size_t ply = 1; ply < plies.size(); ply++) {
+            const PlyStats &stats = plies[ply];
+            if (stats.nodes == 0) continue;
+            std::cout << std::setw(4) << ply << std::setw(12) << stats.nodes << std::setw(12) << stats.cutoffs
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(6) << 100.0 * stats.cutoffs / stats.nodes
+                      << std::setw(8) << 100.0 * stats.firstMoveCutoffs / std::max<u64>(stats.cutoffs, 1)
+                      << std::setprecision(2) << std::setw(10)
+                      << static_cast<double>(stats.cutoffIndexSum) / std::max<u64>(stats.cutoffs, 1) << std::endl;
+        }
+    }
+
+    if (flamePath) {
+        std::ofstream flame(flamePath);
+        for (const auto &line : folder.lines) {
+            if (line.second > 0) flame << line.first << ' ' << line.second << '\n';
+        }
+        if (!flame) {
+            std::cerr << "Could not write " << flamePath << std::endl;
+            return 1;
+        }
+        std::cout << std::endl << folder.lines.size() << " stacks written to " << flamePath << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../bitboard.h"
+#include "../board.h"
+#include "../rng.h"
+#include "../strategy/search.h"
+#include "tuning.h"
+
+// Fits the weights in strategy/weights.h to self-play results (see tuning.h), in two steps:
+//
+//   phantomracer_tune generate OUT [--games N] [--depth N] [--random PERCENT] [--seed N] [--threads N]
+//     plays N games of fixed-depth alphabeta, a PERCENT of the moves at random so the games differ, and
+//     writes every quiet position after the opening to OUT along with the game's result;
+//   phantomracer_tune fit CORPUS [--iterations N] [--rate R] [--threads N] [--output FILE]
+//     fits the weights to the positions in CORPUS and, given --output, writes them out as weights.h.
+//
+// Both spread their work over --threads threads, one per core by default. The fit sums its positions in
+// fixed chunks, so it comes out the same on any number of threads, but a corpus can only be generated
+// again exactly with --threads 1.
+
+#define TUNE_OPENING_PLIES 4
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " generate OUT [--games N] [--depth N] [--random PERCENT] [--seed N] [--threads N]" << std::endl
+              << "       " << program << " fit CORPUS [--iterations N] [--rate R] [--threads N] [--output FILE]" << std::endl;
+}
+
+// Plays one game from a random opening and appends its quiet positions, with the result, to `lines`
+static void playCorpusGame(Rng &rng, int depth, unsigned randomPercent, std::string &lines) {
+    Board board;
+    PieceRange toMove = PieceRange::White;
+    std::vector<std::string> positions;
+
+    for (int ply = 0; board.getGameState() == GameState::IsPlaying; ply++) {
+        auto moves = board.getValidMoves(toMove);
+
+        // Captures swing the heuristic at once, so positions with one pending would teach it noise
+        if (ply >= TUNE_OPENING_PLIES && board.getCaptureMoves(toMove).moves.empty()) {
+            positions.push_back(boardToString(board, toMove));
+        }
+
+        Move move;
+        if (ply < TUNE_OPENING_PLIES || rng.below(100) < randomPercent) {
+            move = moves[rng.below(static_cast<uint32_t>(moves.size()))];
+        } else {
+            SearchContext context;
+            context.verbose = false;
+            transpositionTable.newSearch();
+            move = toMove == PieceRange::Black? searchRoot<PieceRange::Black>(context, board, moves, depth).bestMove
+                                              : searchRoot<PieceRange::White>(context, board, moves, depth).bestMove;
+        }
+        board.performMove(toMove, move);
+        toMove = opponentOf(toMove);
+    }
+
+    const char* result = board.getGameState() == GameState::BlackWins? " 1\n" : " 0\n";
+    for (const auto &position : positions) lines += position + result;
+}
+
+static int generate(const std::string &path, int games, int depth, unsigned randomPercent, u64 seed, unsigned threadCount) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not write " << path << std::endl;
+        return 1;
+    }
+
+    std::atomic<int> nextGame{0};
+    std::mutex fileMutex;
+    auto work = [&]() {
+        std::string lines;
+        for (int game; (game = nextGame.fetch_add(1)) < games;) {
+            // Every game has its own generator, but the searches of all threads share the transposition
+            // table, so what they find depends on how the games interleave
+            Rng rng(seed + static_cast<u64>(game));
+            playCorpusGame(rng, depth, randomPercent, lines);
+
+            std::lock_guard<std::mutex> lock(fileMutex);
+            file << lines;
+            lines.clear();
+            if ((game + 1) % 100 == 0) std::cout << "Game " << game + 1 << '\r' << std::flush;
+        }
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++) threads.emplace_back(work);
+    work();
+    for (auto &thread : threads) thread.join();
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << '\r' << games << " games written to " << path << " in " << elapsedMs << "ms" << std::endl;
+    return file? 0 : 1;
+}
+
+static int fit(const std::string &path, int iterations, double rate, unsigned threadCount, const char* outputPath) {
+    std::vector<TuningPosition> positions;
+    size_t skipped = loadTuningCorpus(path, positions);
+    if (positions.empty()) {
+        std::cerr << "No positions in " << path << std::endl;
+        return 1;
+    }
+    std::cout << positions.size() << " positions (" << skipped << " lines skipped), "
+              << positions.size() * sizeof(TuningPosition) / 1024 << " KiB" << std::endl;
+
+    TexelTuner tuner(positions, threadCount);
+    auto startTime = std::chrono::steady_clock::now();
+
+    // The scale is fitted to the current weights once and then held, which leaves the weights to carry
+    // any improvement instead of just stretching the sigmoid
+    TuningWeights weights = engineWeights();
+    double scale = tuner.fitScale(weights);
+    double errorBefore = tuner.error(weights, scale);
+    std::cout << "Scale " << scale << ", error " << errorBefore << std::endl;
+
+    weights = tuner.fit(weights, scale, iterations, rate, true);
+    TuningWeights rounded;
+    for (int i = 0; i < TUNING_FEATURES; i++) rounded[i] = std::round(weights[i]);
+    double errorAfter = tuner.error(rounded, scale);
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << std::endl << "Weight        Before  After" << std::endl;
+    TuningWeights before = engineWeights();
+    for (int i = 0; i < TUNING_FEATURES; i++) {
+        std::cout << std::left << std::setw(12) << TUNING_FEATURE_NAMES[i] << std::right
+                  << std::setw(8) << before[i] << std::setw(7) << rounded[i] << std::endl;
+    }
+    std::cout << "Error " << errorBefore << " -> " << errorAfter << " in " << elapsedMs << "ms on "
+              << std::max(1u, threadCount) << " threads" << std::endl;
+
+    if (outputPath) {
+        if (!writeWeightsHeader(outputPath, rounded, positions.size(), errorBefore, errorAfter)) {
+            std::cerr << "Could not write " << outputPath << std::endl;
+            return 1;
+        }
+        std::cout << "Written to " << outputPath << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 || (strcmp(argv[1], "generate") != 0 && strcmp(argv[1], "fit") != 0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const bool generating = !strcmp(argv[1], "generate");
+    const std::string path = argv[2];
+
+    int games = 1000, depth = 3, iterations = 1000;
+    unsigned randomPercent = 10;
+    double rate = 0.5;
+    u64 seed = 1;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const char* outputPath = nullptr;
+
+    for (int i = 3; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threadCount = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else if (generating && !strcmp(argv[i], "--games") && i + 1 < argc) {
+            games = std::max(1, atoi(argv[++i]));
+        } else if (generating && !strcmp(argv[i], "--depth") && i + 1 < argc) {
+            depth = std::max(2, atoi(argv[++i]));
+        } else if (generating && !strcmp(argv[i], "--random") && i + 1 < argc) {
+            randomPercent = static_cast<unsigned>(std::max(0, std::min(100, atoi(argv[++i]))));
+        } else if (generating && !strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!generating && !strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (!generating && !strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (!generating && !strcmp(argv[i], "--output") && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    initAll();
+    return generating? generate(path, games, depth, randomPercent, seed, threadCount)
+                     : fit(path, iterations, rate, threadCount, outputPath);
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../board.h"
+#include "../structure.h"
+#include "../strategy/search.h"
+
+// Texel tuning of the weights in strategy/weights.h: the heuristic, squashed through a sigmoid, is read
+// as black's chance of winning, and the weights are fitted so that it predicts the results of self-play
+// games from their positions as well as possible. The heuristic is linear in the weights, so each corpus
+// position is reduced once to how many of each weighted thing black has more than white, and scoring it
+// under other weights is a dot product. bench/tune.cpp generates the corpus and runs the fit.
+
+#define TUNING_FEATURES 5
+
+// Least a fitted weight may be. Quiescence orders captures and stops delta pruning by PIECE_VALUES, which
+// only works while every piece is worth something, and a car that has driven further is never worse off.
+#define TUNING_MIN_WEIGHT 1.0
+
+static const char* const TUNING_FEATURE_NAMES[TUNING_FEATURES] = {"pawn", "knight", "rook", "bishop", "car column"};
+
+using TuningWeights = std::array<double, TUNING_FEATURES>;
+
+// A corpus position as the heuristic sees it. The structure term isn't tuned and is kept as it scores.
+struct TuningPosition {
+    int8_t features[TUNING_FEATURES];   // Black's surplus of each weighted thing
+    uint8_t blackWon;
+    int16_t fixedScore;
+};
+
+static_assert(sizeof(TuningPosition) == 8, "Corpus positions should stay compact");
+
+template<PieceRange range>
+inline void countFeatures(const Board &board, int counts[TUNING_FEATURES]) {
+    using Side = SideTraits<range>;
+    counts[0] = __builtin_popcountll(board.pieces[Side::pawn]);
+    counts[1] = __builtin_popcountll(board.pieces[Side::knight]);
+    counts[2] = __builtin_popcountll(board.pieces[Side::rook]);
+    counts[3] = __builtin_popcountll(board.pieces[Side::bishop]);
+    counts[4] = __builtin_ctzll(board.pieces[Side::car]) % 8;
+}
+
+inline TuningPosition tuningPosition(const Board &board, bool blackWon) {
+    int black[TUNING_FEATURES], white[TUNING_FEATURES];
+    countFeatures<PieceRange::Black>(board, black);
+    countFeatures<PieceRange::White>(board, white);
+
+    TuningPosition position{};
+    for (int i = 0; i < TUNING_FEATURES; i++) position.features[i] = static_cast<int8_t>(black[i] - white[i]);
+    position.blackWon = blackWon;
+#if STRUCTURE_EVAL
+    position.fixedScore = static_cast<int16_t>(evaluateStructure(board).total());
+#endif
+    return position;
+}
+
+// The weights strategy/weights.h currently holds
+inline TuningWeights engineWeights() {
+    return TuningWeights{static_cast<double>(PIECE_VALUES[BlackPawn]), static_cast<double>(PIECE_VALUES[BlackKnight]),
+                         static_cast<double>(PIECE_VALUES[BlackRook]), static_cast<double>(PIECE_VALUES[BlackBishop]),
+                         static_cast<double>(CAR_COLUMN_VALUE)};
+}
+
+// What heuristic() would score the position under `weights`
+inline double tunedScore(const TuningPosition &position, const TuningWeights &weights) {
+    double score = position.fixedScore;
+    for (int i = 0; i < TUNING_FEATURES; i++) score += position.features[i] * weights[i];
+    return score;
+}
+
+// Reads "POSITION RESULT" lines, RESULT being 1 for a black win and 0 for a white one, and returns how
+// many lines had to be skipped
+inline size_t loadTuningCorpus(const std::string &path, std::vector<TuningPosition> &positions) {
+    std::ifstream file(path);
+    std::string line;
+    size_t skipped = 0;
+    while (std::getline(file, line)) {
+        size_t split = line.rfind(' ');
+        Board board;
+        PieceRange range;
+        if (split == std::string::npos || split + 1 >= line.size() || (line[split + 1] != '0' && line[split + 1] != '1')
+            || !parseBoard(line.substr(0, split), board, range)) {
+            skipped++;
+            continue;
+        }
+        positions.push_back(tuningPosition(board, line[split + 1] == '1'));
+    }
+    return skipped;
+}
+
+// Positions summed together before their sums are added up, however many threads there are
+#define TUNING_CHUNK 4096
+
+// Mean squared error of the predictions and its gradient, split over threads by chunks of positions. Each
+// chunk is summed on its own and the chunks' sums are added up in order, so the numbers come out the same
+// on every run and on any number of threads.
+class TexelTuner {
+public:
+    TexelTuner(const std::vector<TuningPosition> &positions, unsigned threadCount)
+            : positions(positions), threadCount(std::max(1u, threadCount)) {}
+
+    double error(const TuningWeights &weights, double scale) const {
+        TuningWeights gradient;
+        return evaluate(weights, scale, false, gradient);
+    }
+
+    double errorAndGradient(const TuningWeights &weights, double scale, TuningWeights &gradient) const {
+        return evaluate(weights, scale, true, gradient);
+    }
+
+    // The sigmoid's scale that fits `weights` best. The error is unimodal in it, so a golden-section
+    // search over its logarithm finds it.
+    double fitScale(const TuningWeights &weights) const {
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double low = std::log(1e-5), high = std::log(1.0);
+        for (int i = 0; i < 40; i++) {
+            double a = high - ratio * (high - low), b = low + ratio * (high - low);
+            if (error(weights, std::exp(a)) < error(weights, std::exp(b))) high = b; else low = a;
+        }
+        return std::exp((low + high) / 2);
+    }
+
+    // Adam over the whole corpus per step. The steps are in heuristic points, which the weights are
+    // counted in as well, so one rate suits all of them. Weights are held at TUNING_MIN_WEIGHT rather
+    // than let through it, with a warning, since a corpus pushing one there says more about the corpus.
+    TuningWeights fit(TuningWeights weights, double scale, int iterations, double rate, bool verbose) const {
+        TuningWeights mean{}, variance{};
+        bool held[TUNING_FEATURES] = {};
+        const double beta1 = 0.9, beta2 = 0.999;
+        for (int step = 1; step <= iterations; step++) {
+            TuningWeights gradient;
+            double stepError = errorAndGradient(weights, scale, gradient);
+            for (int i = 0; i < TUNING_FEATURES; i++) {
+                mean[i] = beta1 * mean[i] + (1 - beta1) * gradient[i];
+                variance[i] = beta2 * variance[i] + (1 - beta2) * gradient[i] * gradient[i];
+                double meanHat = mean[i] / (1 - std::pow(beta1, step));
+                double varianceHat = variance[i] / (1 - std::pow(beta2, step));
+                weights[i] -= rate * meanHat / (std::sqrt(varianceHat) + 1e-12);
+                if (weights[i] < TUNING_MIN_WEIGHT) {
+                    weights[i] = TUNING_MIN_WEIGHT;
+                    held[i] = true;
+                }
+            }
+            if (verbose && (step % 100 == 0 || step == iterations)) {
+                std::cout << "Step " << step << ": error " << stepError << std::endl;
+            }
+        }
+        for (int i = 0; i < TUNING_FEATURES; i++) {
+            if (verbose && held[i]) {
+                std::cerr << "Warning: the fit tried to take " << TUNING_FEATURE_NAMES[i] << " below "
+                          << TUNING_MIN_WEIGHT << " and it was held there" << std::endl;
+            }
+        }
+        return weights;
+    }
+
+private:
+    const std::vector<TuningPosition> &positions;
+    unsigned threadCount;
+
+    struct Partial {
+        double error = 0;
+        TuningWeights gradient{};
+    };
+
+    double evaluate(const TuningWeights &weights, double scale, bool withGradient, TuningWeights &gradient) const {
+        std::vector<Partial> partials((positions.size() + TUNING_CHUNK - 1) / TUNING_CHUNK);
+        auto work = [&](unsigned thread) {
+            for (size_t chunk = thread; chunk < partials.size(); chunk += threadCount) {
+                size_t begin = chunk * TUNING_CHUNK, end = std::min(positions.size(), begin + TUNING_CHUNK);
+                Partial partial;
+                for (size_t i = begin; i < end; i++) {
+                    const TuningPosition &position = positions[i];
+                    double predicted = 1 / (1 + std::exp(-scale * tunedScore(position, weights)));
+                    double difference = position.blackWon - predicted;
+                    partial.error += difference * difference;
+                    if (withGradient) {
+                        double slope = -2 * difference * predicted * (1 - predicted) * scale;
+                        for (int j = 0; j < TUNING_FEATURES; j++) partial.gradient[j] += slope * position.features[j];
+                    }
+                }
+                // Summed locally, so threads don't share cache lines while they work
+                partials[chunk] = partial;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned thread = 1; thread < threadCount; thread++) threads.emplace_back(work, thread);
+        work(0);
+        for (auto &thread : threads) thread.join();
+
+        double total = 0;
+        gradient.fill(0);
+        for (const auto &partial : partials) {
+            total += partial.error;
+            for (int j = 0; j < TUNING_FEATURES; j++) gradient[j] += partial.gradient[j];
+        }
+        const double count = std::max<double>(1, positions.size());
+        for (auto &value : gradient) value /= count;
+        return total / count;
+    }
+};
+
+// Writes strategy/weights.h for `weights`, rounded to whole points
+inline bool writeWeightsHeader(const std::string &path, const TuningWeights &weights, size_t positionCount,
+                               double errorBefore, double errorAfter) {
+    int rounded[TUNING_FEATURES];
+    for (int i = 0; i < TUNING_FEATURES; i++) rounded[i] = static_cast<int>(std::lround(weights[i]));
+
+    std::ofstream file(path);
+    file << "#pragma once\n\n"
+         << "// Piece weights for the heuristic in search.h. bench/tune.cpp rewrites this file with weights fitted to\n"
+         << "// self-play results; see there before editing it by hand.\n"
+         << "//\n"
+         << "// Fitted to " << positionCount << " positions, mean squared error " << errorBefore << " -> " << errorAfter << "\n\n"
+         << "// Indexed by PieceType; cars can't be captured, their worth is in how far along they are\n"
+         << "static const int PIECE_VALUES[11] = {0";
+    for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < 4; i++) file << ", " << rounded[i];
+        file << ", 0";
+    }
+    file << "};\n\n"
+         << "// Per column a car has driven\n"
+         << "static const int CAR_COLUMN_VALUE = " << rounded[4] << ";\n";
+    return static_cast<bool>(file);
+}
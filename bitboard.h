@@ -2,6 +2,12 @@
 
 #include "types.h"
 
+#define SIMD_ATTACKS true
+
+#if SIMD_ATTACKS && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 const u64 rightColMask = C64(0x7F7F7F7F7F7F7F7F);
 const u64 leftColMask  = C64(0xFEFEFEFEFEFEFEFE);
 const u64 rightTwoColMask = rightColMask & C64(0xBFBFBFBFBFBFBFBF);
@@ -26,6 +32,7 @@ u64 maskPieceLookupTable[64];
 u64 knightLookupTable[64];
 u64 rayLookupTable[8][64];
 u64 zobristTable[11][64];
+u64 zobristBlackToMove;
 
 class BitBoard {
 public:
@@ -43,6 +50,72 @@ public:
     }
 };
 
+template<ScanDirection direction>
+constexpr unsigned directionStep() {
+    return direction == North || direction == South ? 8 :
+           direction == NorthWest || direction == SouthEast ? 7 :
+           direction == NorthEast || direction == SouthWest ? 9 : 1;
+}
+
+template<ScanDirection direction>
+inline u64 shiftTowards(u64 bits, unsigned steps = 1) {
+    if constexpr (direction < South) {
+        return bits << (directionStep<direction>() * steps);
+    } else {
+        return bits >> (directionStep<direction>() * steps);
+    }
+}
+
+// Set-wise sliding attacks in one direction for every slider in `sliders` at once (a Kogge-Stone occluded
+// fill). Column H is never in `empty`, which stops fills from wrapping around the 7-column board. The result
+// includes the first blocker on each ray, whichever side it belongs to. Every target square is reached from
+// at most one slider, because a slider behind another is blocked by it.
+template<ScanDirection direction>
+inline u64 slidingAttacks(u64 sliders, u64 empty) {
+    empty &= rightColMask;
+
+    sliders |= empty & shiftTowards<direction>(sliders, 1);
+    empty &= shiftTowards<direction>(empty, 1);
+    sliders |= empty & shiftTowards<direction>(sliders, 2);
+    empty &= shiftTowards<direction>(empty, 2);
+    sliders |= empty & shiftTowards<direction>(sliders, 4);
+
+    return shiftTowards<direction>(sliders, 1) & rightColMask;
+}
+
+// slidingAttacks() in four directions at once, e.g. all the ways a side's rooks can go. With AVX2 each
+// direction gets a 64-bit lane of one register. A lane shifts left by its step and then right by zero, or
+// the other way round, so every lane can run the same instructions.
+template<ScanDirection d0, ScanDirection d1, ScanDirection d2, ScanDirection d3>
+inline void slidingAttacks4(u64 sliders, u64 empty, u64 (&attacks)[4]) {
+#if SIMD_ATTACKS && defined(__AVX2__)
+    const __m256i left = _mm256_setr_epi64x(d0 < South? directionStep<d0>() : 0, d1 < South? directionStep<d1>() : 0,
+                                            d2 < South? directionStep<d2>() : 0, d3 < South? directionStep<d3>() : 0);
+    const __m256i right = _mm256_setr_epi64x(d0 < South? 0 : directionStep<d0>(), d1 < South? 0 : directionStep<d1>(),
+                                             d2 < South? 0 : directionStep<d2>(), d3 < South? 0 : directionStep<d3>());
+    const __m256i left2 = _mm256_slli_epi64(left, 1), right2 = _mm256_slli_epi64(right, 1);
+    const __m256i left4 = _mm256_slli_epi64(left, 2), right4 = _mm256_slli_epi64(right, 2);
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(rightColMask));
+
+    __m256i gen = _mm256_set1_epi64x(static_cast<long long>(sliders));
+    __m256i pro = _mm256_set1_epi64x(static_cast<long long>(empty & rightColMask));
+
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(_mm256_sllv_epi64(gen, left), right)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(_mm256_sllv_epi64(pro, left), right));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(_mm256_sllv_epi64(gen, left2), right2)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(_mm256_sllv_epi64(pro, left2), right2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(_mm256_sllv_epi64(gen, left4), right4)));
+
+    gen = _mm256_and_si256(_mm256_srlv_epi64(_mm256_sllv_epi64(gen, left), right), mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(attacks), gen);
+#else
+    attacks[0] = slidingAttacks<d0>(sliders, empty);
+    attacks[1] = slidingAttacks<d1>(sliders, empty);
+    attacks[2] = slidingAttacks<d2>(sliders, empty);
+    attacks[3] = slidingAttacks<d3>(sliders, empty);
+#endif
+}
+
 void initPieceLookupTable() {
     for (u64 i = 0; i < 64; i++) {
         u64 piece = static_cast<u64>(1) << i;
@@ -179,12 +252,44 @@ void initRayLookupTable() {
     }
 }
 
+// One step of SplitMix64, a small generator with good enough output to fill the Zobrist table
+inline u64 splitMix64(u64 &state) {
+    u64 z = (state += C64(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30u)) * C64(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27u)) * C64(0x94D049BB133111EB);
+    return z ^ (z >> 31u);
+}
+
+#define ZOBRIST_SEED C64(0x5048414E544F4D52)
+
 void initZobrist() {
-    for (int i = 0; i <= 10; i++) {
+    // Keys come from a fixed seed rather than rand(), so hashes are the same in every run and on every
+    // platform. The persistent transposition table depends on that.
+    u64 seed = ZOBRIST_SEED;
+
+    // EmptyPiece keys stay zero so that clearing an empty square never changes a hash
+    for (int j = 0; j < 64; j++) {
+        zobristTable[EmptyPiece][j] = 0;
+    }
+
+    for (int i = 1; i <= 10; i++) {
+        for (int j = 0; j < 64; j++) {
+            zobristTable[i][j] = splitMix64(seed);
+        }
+    }
+
+    zobristBlackToMove = splitMix64(seed);
+}
+
+// Identifies the set of Zobrist keys, so that hashes stored under other keys are never trusted
+u64 zobristFingerprint() {
+    u64 fingerprint = zobristBlackToMove;
+    for (int i = 1; i <= 10; i++) {
         for (int j = 0; j < 64; j++) {
-            zobristTable[i][j] = (static_cast<u64>(rand()) << 32) | rand();
+            fingerprint = (fingerprint ^ zobristTable[i][j]) * C64(0x100000001B3);
         }
     }
+    return fingerprint;
 }
 
 void initAll() {
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <iostream>
 #include <ostream>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 
@@ -8,183 +11,348 @@
 #include "bitboard.h"
 #include "color.h"
 #include "move.h"
+#include "side.h"
 
+using std::cout;
 using std::endl;
 
 //static std::unordered_map<u64, std::vector<Move>> zobristWhiteMap;
 //static std::unordered_map<u64, std::vector<Move>> zobristBlackMap;
 
+// Selects the pieces that go into Board::structureKey, indexed by PieceType
+static constexpr u64 STRUCTURE_KEY_MASK[11] = {0, U64_MAX, 0, 0, 0, U64_MAX, U64_MAX, 0, 0, 0, U64_MAX};
+
+// Number of legal moves per piece type for one side
+struct Mobility {
+    int pawn = 0;
+    int knight = 0;
+    int rook = 0;
+    int bishop = 0;
+    int car = 0;
+
+    int total() const { return pawn + knight + rook + bishop + car; }
+};
+
 class Board {
 public:
-    BitBoard whitePawns     = 0b0000000000000000000000000000000001111000000001000000001000000000;
-    BitBoard whiteKnights   = 0b0000000000000000000000000000000000000011000000000000000000000000;
-    BitBoard whiteRooks     = 0b0000000000000000000000000000000000000000000000110000000000000000;
-    BitBoard whiteBishops   = 0b0000000000000000000000000000000000000000000110000000000000000000;
-    BitBoard whiteCar       = 0b0000000000000000000000000000000000000000000000000000000000000001;
-
-    BitBoard blackPawns     = 0b0000000000000010000001000111100000000000000000000000000000000000;
-    BitBoard blackKnights   = 0b0000000000000000000000000000001100000000000000000000000000000000;
-    BitBoard blackRooks     = 0b0000000000000000000000110000000000000000000000000000000000000000;
-    BitBoard blackBishops   = 0b0000000000000000000110000000000000000000000000000000000000000000;
-    BitBoard blackCar       = 0b0000000100000000000000000000000000000000000000000000000000000000;
-
-    BitBoard allWhitePieces;
-    BitBoard allBlackPieces;
-    BitBoard allPieces;
+    // Indexed by PieceType; pieces[EmptyPiece] is always empty
+    u64 pieces[11] = {
+        0,
+        0b0000000000000010000001000111100000000000000000000000000000000000, // BlackPawn
+        0b0000000000000000000000000000001100000000000000000000000000000000, // BlackKnight
+        0b0000000000000000000000110000000000000000000000000000000000000000, // BlackRook
+        0b0000000000000000000110000000000000000000000000000000000000000000, // BlackBishop
+        0b0000000100000000000000000000000000000000000000000000000000000000, // BlackCar
+        0b0000000000000000000000000000000001111000000001000000001000000000, // WhitePawn
+        0b0000000000000000000000000000000000000011000000000000000000000000, // WhiteKnight
+        0b0000000000000000000000000000000000000000000000110000000000000000, // WhiteRook
+        0b0000000000000000000000000000000000000000000110000000000000000000, // WhiteBishop
+        0b0000000000000000000000000000000000000000000000000000000000000001, // WhiteCar
+    };
+
+    // Indexed by SideTraits<range>::index
+    u64 occupancy[2];
+    u64 allPieces;
+
+    // What stands on each square, kept in sync with the bitboards so captures never have to probe them
+    PieceType mailbox[64];
+
+    // Zobrist key of the piece placement, updated incrementally by performMove()
+    u64 key;
+
+    // Key of the mirrored placement: ranks flipped and colours swapped, which is the same game from the
+    // other side. Kept alongside `key` so canonicalHash() costs nothing.
+    u64 mirrorKey;
+
+    // Zobrist key of the pawns and cars alone, which move far less often than the rest; the structure
+    // cache in structure.h is keyed by it
+    u64 structureKey;
 
     Board() {
         updatePieceAggregates();
     }
 
-    Board(const Board &oldBoard) {
-        whitePawns = oldBoard.whitePawns;
-        whiteRooks = oldBoard.whiteRooks;
-        whiteKnights = oldBoard.whiteKnights;
-        whiteBishops = oldBoard.whiteBishops;
-        whiteCar = oldBoard.whiteCar;
-
-        blackPawns = oldBoard.blackPawns;
-        blackRooks = oldBoard.blackRooks;
-        blackKnights = oldBoard.blackKnights;
-        blackBishops = oldBoard.blackBishops;
-        blackCar = oldBoard.blackCar;
-
+    void clear() {
+        for (u64 &bits : pieces) bits = 0;
         updatePieceAggregates();
     }
 
+    // Rebuilds occupancy, mailbox and key from the piece bitboards after they were edited directly
     inline void updatePieceAggregates() {
-        allWhitePieces = whitePawns.bits | whiteRooks.bits | whiteKnights.bits | whiteBishops.bits | whiteCar.bits;
-        allBlackPieces = blackPawns.bits | blackRooks.bits | blackKnights.bits | blackBishops.bits | blackCar.bits;
-        allPieces = allWhitePieces.bits | allBlackPieces.bits;
+        occupancy[SideTraits<PieceRange::Black>::index] =
+                pieces[BlackPawn] | pieces[BlackKnight] | pieces[BlackRook] | pieces[BlackBishop] | pieces[BlackCar];
+        occupancy[SideTraits<PieceRange::White>::index] =
+                pieces[WhitePawn] | pieces[WhiteKnight] | pieces[WhiteRook] | pieces[WhiteBishop] | pieces[WhiteCar];
+        allPieces = occupancy[0] | occupancy[1];
+
+        for (auto &square : mailbox) square = EmptyPiece;
+        for (int i = 1; i <= 10; i++) {
+            u64 bits = pieces[i];
+            while (bits) {
+                mailbox[__builtin_ctzll(bits)] = static_cast<PieceType>(i);
+                bits &= bits - 1;
+            }
+        }
+
+        key = computeHash();
+        mirrorKey = computeHash(true);
+        structureKey = computeStructureKey();
+    }
+
+    inline PieceType pieceAt(u8 square) const {
+        return mailbox[square];
+    }
+
+    // Toggles a piece using screen coordinates (y = 0 is rank 8); call updatePieceAggregates() afterwards
+    void flipBit(PieceType pieceType, int x, int y) {
+        BitBoard board(pieces[pieceType]);
+        board.flipBit(x, y);
+        pieces[pieceType] = board.bits;
+    }
+
+    bool isBitSet(PieceType pieceType, int x, int y) const {
+        return BitBoard(pieces[pieceType]).isBitSet(x, y);
+    }
+
+    template<PieceRange range>
+    inline MoveList getValidMoves(bool includeCar = true) const {
+        std::vector<Move> moveVector;
+        moveVector.reserve(32);
+
+        MoveList moves(moveVector);
+        addPawnMoves<range>(moves);
+        addKnightMoves<range>(moves);
+        addRookMoves<range>(moves);
+        addBishopMoves<range>(moves);
+        if (includeCar) addCarMove<range>(moves);
+
+        return moves;
     }
 
     inline MoveList getValidMoves(PieceRange range, bool includeCar = true) const {
         if (range == PieceRange::White) {
-            std::vector<Move> moveVector;
-            moveVector.reserve(32);
+            return getValidMoves<PieceRange::White>(includeCar);
+        } else {
+            return getValidMoves<PieceRange::Black>(includeCar);
+        }
+    }
+
+    // Just the captures of getValidMoves(), for the quiescence search. Cars never capture by choice, so
+    // they are left out, and quiet pawn pushes and forward slides are never generated at all.
+    template<PieceRange range>
+    inline MoveList getCaptureMoves() const {
+        std::vector<Move> moveVector;
+        moveVector.reserve(8);
 
-            MoveList moves(moveVector);
-            addWhitePawnMoves(moves);
-            addWhiteKnightMoves(moves);
-            addWhiteRookMoves(moves);
-            addWhiteBishopMoves(moves);
-            if (includeCar) addWhiteCarMove(moves);
+        MoveList moves(moveVector);
+        addPawnCaptures<range>(moves);
+        addKnightCaptures<range>(moves);
+        addRookCaptures<range>(moves);
+        addBishopCaptures<range>(moves);
+
+        return moves;
+    }
 
-            return moves;
+    inline MoveList getCaptureMoves(PieceRange range) const {
+        if (range == PieceRange::White) {
+            return getCaptureMoves<PieceRange::White>();
         } else {
-            std::vector<Move> moveVector;
-            moveVector.reserve(32);
+            return getCaptureMoves<PieceRange::Black>();
+        }
+    }
 
-            MoveList moves(moveVector);
-            addBlackPawnMoves(moves);
-            addBlackKnightMoves(moves);
-            addBlackRookMoves(moves);
-            addBlackBishopMoves(moves);
-            if (includeCar) addBlackCarMove(moves);
+    // Counts what getValidMoves() would generate, using set-wise attacks and popcounts instead of building a
+    // move list. Pawn, knight and per-direction slider targets each come from exactly one piece, so summing
+    // their popcounts counts moves. Once a car has finished it has no move here.
+    template<PieceRange range>
+    Mobility mobility(bool includeCar = true) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        const u64 empty = ~allPieces & rightColMask;
+        const u64 captures = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
+        const u64 quiet = empty | captures;
+        Mobility result;
+
+        const u64 pawns = pieces[Side::pawn];
+        result.pawn = __builtin_popcountll(Side::advance(pawns, 9u) & Side::pawnCapture9Mask & captures)
+                    + __builtin_popcountll(Side::advance(pawns, 7u) & Side::pawnCapture7Mask & captures)
+                    + __builtin_popcountll(Side::advance(pawns, 8u) & empty);
+
+        // Knights jump anywhere forward, but only capture backward
+        const u64 knights = pieces[Side::knight];
+        const u64 up = range == PieceRange::White? quiet : captures;
+        const u64 down = range == PieceRange::White? captures : quiet;
+        result.knight = __builtin_popcountll(((knights & leftTwoColMask)  << 6u)  & up)
+                      + __builtin_popcountll(((knights & leftColMask)     << 15u) & up)
+                      + __builtin_popcountll(((knights & rightColMask)    << 17u) & up)
+                      + __builtin_popcountll(((knights & rightTwoColMask) << 10u) & up)
+                      + __builtin_popcountll(((knights & rightTwoColMask) >> 6u)  & down)
+                      + __builtin_popcountll(((knights & rightColMask)    >> 15u) & down)
+                      + __builtin_popcountll(((knights & leftColMask)     >> 17u) & down)
+                      + __builtin_popcountll(((knights & leftTwoColMask)  >> 10u) & down);
+
+        u64 rookAttacks[4];
+        slidingAttacks4<Side::rookForward, Side::rookCaptures[0], Side::rookCaptures[1], Side::rookCaptures[2]>(
+                pieces[Side::rook], empty, rookAttacks);
+        result.rook = __builtin_popcountll(rookAttacks[0] & quiet)
+                    + __builtin_popcountll(rookAttacks[1] & captures)
+                    + __builtin_popcountll(rookAttacks[2] & captures)
+                    + __builtin_popcountll(rookAttacks[3] & captures);
+
+        u64 bishopAttacks[4];
+        slidingAttacks4<Side::bishopForward[0], Side::bishopForward[1], Side::bishopCaptures[0], Side::bishopCaptures[1]>(
+                pieces[Side::bishop], empty, bishopAttacks);
+        result.bishop = __builtin_popcountll(bishopAttacks[0] & quiet)
+                      + __builtin_popcountll(bishopAttacks[1] & quiet)
+                      + __builtin_popcountll(bishopAttacks[2] & captures)
+                      + __builtin_popcountll(bishopAttacks[3] & captures);
+
+        if (includeCar) {
+            const u64 carTarget = carTargetBit<range>();
+            if (carTarget && ((carTarget & allPieces) == 0 || result.total() == 0)) {
+                result.car = 1;
+            }
+        }
 
-            return moves;
+        return result;
+    }
+
+    inline Mobility mobility(PieceRange range, bool includeCar = true) const {
+        if (range == PieceRange::White) {
+            return mobility<PieceRange::White>(includeCar);
+        } else {
+            return mobility<PieceRange::Black>(includeCar);
+        }
+    }
+
+    template<PieceRange range>
+    inline int countMoves(bool includeCar = true) const {
+        return mobility<range>(includeCar).total();
+    }
+
+    inline int countMoves(PieceRange range, bool includeCar = true) const {
+        return mobility(range, includeCar).total();
+    }
+
+    // The square the car would drive to next, or 0 if it is not on its path
+    template<PieceRange range>
+    inline u64 carTargetBit() const {
+        using Side = SideTraits<range>;
+
+        const u64 car = pieces[Side::car];
+        u64 target = 0;
+        for (int i = 0; i < 6; i++) {
+            if (car == pieceLookupTable[Side::carPath[i]]) target = pieceLookupTable[Side::carPath[i + 1]];
         }
+        return target;
     }
 
     GameState getGameState() const {
-        if (unlikely(whiteCar.bits == pieceLookupTable[30])) {
+        if (unlikely(pieces[WhiteCar] == pieceLookupTable[30])) {
             return GameState::WhiteWins;
-        } else if (unlikely(blackCar.bits == pieceLookupTable[38])) {
+        } else if (unlikely(pieces[BlackCar] == pieceLookupTable[38])) {
             return GameState::BlackWins;
         } else {
             return GameState::IsPlaying;
         }
     }
 
-    void performWhiteMove(Move move) {
-        u64 fromMask = maskPieceLookupTable[move.fromCell];
-        u64 toMask = maskPieceLookupTable[move.toCell];
-
-        switch (move.movingPiece) {
-            case WhitePawn:
-                whitePawns.bits &= fromMask;
-                whitePawns.bits |= pieceLookupTable[move.toCell];
-                break;
-            case WhiteKnight:
-                whiteKnights.bits &= fromMask;
-                whiteKnights.bits |= pieceLookupTable[move.toCell];
-                break;
-            case WhiteRook:
-                whiteRooks.bits &= fromMask;
-                whiteRooks.bits |= pieceLookupTable[move.toCell];
-                break;
-            case WhiteBishop:
-                whiteBishops.bits &= fromMask;
-                whiteBishops.bits |= pieceLookupTable[move.toCell];
-                break;
-            case WhiteCar:
-                whitePawns.bits &= toMask;
-                whiteKnights.bits &= toMask;
-                whiteRooks.bits &= toMask;
-                whiteBishops.bits &= toMask;
-                whiteCar.bits = pieceLookupTable[move.toCell];
-                break;
-            default:
-                cout << "Invalid piece type for white move" << endl;
-        }
-
-        blackPawns.bits &= toMask;
-        blackKnights.bits &= toMask;
-        blackRooks.bits &= toMask;
-        blackBishops.bits &= toMask;
+    template<PieceRange range>
+    void performMove(Move move) {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
 
-        updatePieceAggregates();
-    }
+        if (unlikely(move.movingPiece < Side::pawn || move.movingPiece > Side::car)) {
+            cout << "Invalid piece type for " << Side::name << " move" << endl;
+            return;
+        }
 
-    void performBlackMove(Move move) {
-        u64 fromMask = maskPieceLookupTable[move.fromCell];
-        u64 toMask = maskPieceLookupTable[move.toCell];
-
-        switch (move.movingPiece) {
-            case BlackPawn:
-                blackPawns.bits &= fromMask;
-                blackPawns.bits |= pieceLookupTable[move.toCell];
-                break;
-            case BlackKnight:
-                blackKnights.bits &= fromMask;
-                blackKnights.bits |= pieceLookupTable[move.toCell];
-                break;
-            case BlackRook:
-                blackRooks.bits &= fromMask;
-                blackRooks.bits |= pieceLookupTable[move.toCell];
-                break;
-            case BlackBishop:
-                blackBishops.bits &= fromMask;
-                blackBishops.bits |= pieceLookupTable[move.toCell];
-                break;
-            case BlackCar:
-                blackPawns.bits &= toMask;
-                blackKnights.bits &= toMask;
-                blackRooks.bits &= toMask;
-                blackBishops.bits &= toMask;
-                blackCar.bits = pieceLookupTable[move.toCell];
-                break;
-            default:
-                cout << "Invalid piece type for black move" << endl;
-        }
-
-        whitePawns.bits &= toMask;
-        whiteKnights.bits &= toMask;
-        whiteRooks.bits &= toMask;
-        whiteBishops.bits &= toMask;
+        u64 fromBit = pieceLookupTable[move.fromCell];
+        u64 toBit = pieceLookupTable[move.toCell];
+
+        // Whatever is on the target square is taken off, including the car's own pieces when it runs
+        // over them. An empty square clears a bit in pieces[EmptyPiece], which is always empty anyway.
+        PieceType captured = mailbox[move.toCell];
+        pieces[captured] &= ~toBit;
+        key ^= zobristTable[captured][move.toCell];
+        mirrorKey ^= zobristTable[mirrorPiece(captured)][move.toCell ^ 56u];
+        structureKey ^= zobristTable[captured][move.toCell] & STRUCTURE_KEY_MASK[captured];
+
+        pieces[move.movingPiece] ^= fromBit | toBit;
+        key ^= zobristTable[move.movingPiece][move.fromCell] ^ zobristTable[move.movingPiece][move.toCell];
+        mirrorKey ^= zobristTable[mirrorPiece(move.movingPiece)][move.fromCell ^ 56u]
+                   ^ zobristTable[mirrorPiece(move.movingPiece)][move.toCell ^ 56u];
+        structureKey ^= (zobristTable[move.movingPiece][move.fromCell] ^ zobristTable[move.movingPiece][move.toCell])
+                      & STRUCTURE_KEY_MASK[move.movingPiece];
+        mailbox[move.fromCell] = EmptyPiece;
+        mailbox[move.toCell] = move.movingPiece;
+
+        occupancy[Side::index] = (occupancy[Side::index] & ~fromBit) | toBit;
+        occupancy[Opponent::index] &= ~toBit;
+        allPieces = occupancy[0] | occupancy[1];
+    }
 
-        updatePieceAggregates();
+    inline void performMove(PieceRange range, Move move) {
+        if (range == PieceRange::White) {
+            performMove<PieceRange::White>(move);
+        } else {
+            performMove<PieceRange::Black>(move);
+        }
     }
 
     u64 hash() const {
+        return key;
+    }
+
+    // Key for the position together with the side to move, for search tables
+    u64 hash(PieceRange range) const {
+        return range == PieceRange::Black? key ^ zobristBlackToMove : key;
+    }
+
+    // A position and its mirror image with the other side to move are the same game, so they share this
+    // key: the smaller of the two hashes. `mirrored` tells whether it is the mirror image's, in which
+    // case scores stored under it are from the other colour's point of view and moves must be mirrored.
+    u64 canonicalHash(PieceRange range, bool &mirrored) const {
+        u64 own = hash(range);
+        u64 mirror = range == PieceRange::White? mirrorKey ^ zobristBlackToMove : mirrorKey;
+        mirrored = mirror < own;
+        return mirrored? mirror : own;
+    }
+
+    u64 canonicalHash(PieceRange range) const {
+        bool mirrored;
+        return canonicalHash(range, mirrored);
+    }
+
+    // Ranks flipped and colours swapped
+    Board mirrored() const {
+        Board board(*this);
+        for (int i = 0; i <= 10; i++) {
+            board.pieces[mirrorPiece(static_cast<PieceType>(i))] = __builtin_bswap64(pieces[i]);
+        }
+        board.occupancy[0] = __builtin_bswap64(occupancy[1]);
+        board.occupancy[1] = __builtin_bswap64(occupancy[0]);
+        board.allPieces = __builtin_bswap64(allPieces);
+        for (int square = 0; square < 64; square++) {
+            board.mailbox[square ^ 56] = mirrorPiece(mailbox[square]);
+        }
+        board.key = mirrorKey;
+        board.mirrorKey = key;
+        board.structureKey = board.computeStructureKey();
+        return board;
+    }
+
+    // The key from scratch, of the mirrored placement if `mirror` is set
+    u64 computeHash(bool mirror = false) const {
         u64 result = 0;
         u64 bits;
 
         for (int i = 1; i <= 10; i++) {
-            bits = pieceTypeToBoard(static_cast<PieceType>(i)).bits;
+            bits = pieces[i];
             while (bits) {
                 auto firstBit = static_cast<u8>(__builtin_ctzll(bits));
-                result ^= zobristTable[i][firstBit];
+                result ^= mirror? zobristTable[mirrorPiece(static_cast<PieceType>(i))][firstBit ^ 56u] : zobristTable[i][firstBit];
                 bits &= bits - 1;
             }
         }
@@ -192,279 +360,288 @@ public:
         return result;
     }
 
-private:
-    void addWhitePawnMoves(MoveList &moves) const {
-        BitBoard pawnBoard;
-
-        pawnBoard.bits = whitePawns.bits << 9u & leftColMask & allBlackPieces.bits & ~blackCar.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{WhitePawn, static_cast<u8>(firstBit - 9), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
+    u64 computeStructureKey() const {
+        u64 result = 0;
+        for (PieceType type : {BlackPawn, BlackCar, WhitePawn, WhiteCar}) {
+            u64 bits = pieces[type];
+            while (bits) {
+                result ^= zobristTable[type][__builtin_ctzll(bits)];
+                bits &= bits - 1;
+            }
         }
+        return result;
+    }
 
-        pawnBoard.bits = whitePawns.bits << 7u & rightColMask & allBlackPieces.bits & ~blackCar.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{WhitePawn, static_cast<u8>(firstBit - 7), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
-        }
+    template<PieceRange range>
+    inline u64 sidePieces() const {
+        return occupancy[SideTraits<range>::index];
+    }
 
-        pawnBoard.bits = whitePawns.bits << 8u & ~allPieces.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{WhitePawn, static_cast<u8>(firstBit - 8), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
+    template<ScanDirection direction>
+    inline u64 getRayAttacks(u64 friendly, u8 square) const {
+        if constexpr (direction < South) {
+            return getPositiveRayAttacks(friendly, direction, square);
+        } else {
+            return getNegativeRayAttacks(friendly, direction, square);
         }
     }
 
-    void addBlackPawnMoves(MoveList &moves) const {
-        BitBoard pawnBoard;
+    inline u64 getPositiveRayAttacks(u64 friendly, ScanDirection direction, u8 square) const {
+        u64 attacks = rayLookupTable[direction][square];
+        u64 blocker = attacks & allPieces;
+        square = static_cast<u8>(__builtin_ctzll(blocker | C64(0x8000000000000000)));
+        u64 friendMask = friendly & pieceLookupTable[square];
+        return attacks ^ rayLookupTable[direction][square] ^ friendMask;
+    }
 
-        pawnBoard.bits = blackPawns.bits >> 9u & rightColMask & allWhitePieces.bits & ~whiteCar.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{BlackPawn, static_cast<u8>(firstBit + 9), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
+    inline u64 getNegativeRayAttacks(u64 friendly, ScanDirection direction, u8 square) const {
+        u64 attacks = rayLookupTable[direction][square];
+        u64 blocker = attacks & allPieces;
+        square = static_cast<u8>(63 - __builtin_clzll(blocker | C64(1)));
+        // Square 0 is only the sentinel when there is no blocker, so it must not pick up a friendly piece there
+        u64 friendMask = blocker & friendly & pieceLookupTable[square];
+        return attacks ^ rayLookupTable[direction][square] ^ friendMask;
+    }
+
+private:
+    template<PieceRange range>
+    void addPawnMoves(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        const u64 pawns = pieces[Side::pawn];
+        const u64 targets = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
+        u64 pawnBoard;
+
+        pawnBoard = Side::advance(pawns, 9u) & Side::pawnCapture9Mask & targets;
+        while (pawnBoard) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard));
+            moves.moves.push_back(Move{Side::pawn, Side::retreat(firstBit, 9u), firstBit});
+            pawnBoard &= pawnBoard - 1;
         }
 
-        pawnBoard.bits = blackPawns.bits >> 7u & leftColMask & allWhitePieces.bits & ~whiteCar.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{BlackPawn, static_cast<u8>(firstBit + 7), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
+        pawnBoard = Side::advance(pawns, 7u) & Side::pawnCapture7Mask & targets;
+        while (pawnBoard) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard));
+            moves.moves.push_back(Move{Side::pawn, Side::retreat(firstBit, 7u), firstBit});
+            pawnBoard &= pawnBoard - 1;
         }
 
-        pawnBoard.bits = blackPawns.bits >> 8u & ~allPieces.bits;
-        while (pawnBoard.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard.bits));
-            moves.moves.push_back(Move{BlackPawn, static_cast<u8>(firstBit + 8), firstBit});
-            pawnBoard.bits &= pawnBoard.bits - 1;
+        pawnBoard = Side::advance(pawns, 8u) & ~allPieces;
+        while (pawnBoard) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard));
+            moves.moves.push_back(Move{Side::pawn, Side::retreat(firstBit, 8u), firstBit});
+            pawnBoard &= pawnBoard - 1;
         }
     }
 
-    void addWhiteKnightMoves(MoveList &moves) const {
-        BitBoard knights(whiteKnights);
-        while (knights.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(knights.bits));
-            knights.bits &= knights.bits - 1;
+    template<PieceRange range>
+    void addKnightMoves(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        const u64 enemyCar = pieces[Opponent::car];
+        const u64 enemies = sidePieces<Side::opponent>();
+
+        u64 knights = pieces[Side::knight];
+        while (knights) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(knights));
+            knights &= knights - 1;
 
-            BitBoard attack = knightLookupTable[firstBit] & ~(allWhitePieces.bits | blackCar.bits);
+            u64 attack = knightLookupTable[firstBit] & ~(sidePieces<range>() | enemyCar);
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                if (secondBit > firstBit) {
-                    moves.moves.push_back(Move{WhiteKnight, firstBit, secondBit});
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                if (Side::isForward(firstBit, secondBit)) {
+                    moves.moves.push_back(Move{Side::knight, firstBit, secondBit});
                 } else {
                     u64 testBit = C64(1) << secondBit;
-                    if ((testBit & allBlackPieces.bits) && (testBit ^ blackCar.bits)) {
-                        moves.moves.push_back(Move{WhiteKnight, firstBit, secondBit});
+                    if ((testBit & enemies) && (testBit ^ enemyCar)) {
+                        moves.moves.push_back(Move{Side::knight, firstBit, secondBit});
                     }
                 }
-                attack.bits &= attack.bits - 1;
+                attack &= attack - 1;
             }
         }
     }
 
-    void addBlackKnightMoves(MoveList &moves) const {
-        BitBoard knights(blackKnights);
-        while (knights.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(knights.bits));
-            knights.bits &= knights.bits - 1;
+    template<PieceRange range>
+    void addRookMoves(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
 
-            BitBoard attack = knightLookupTable[firstBit] & ~(allBlackPieces.bits | whiteCar.bits);
+        const u64 friendly = sidePieces<range>();
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                if (secondBit < firstBit) {
-                    moves.moves.push_back(Move{BlackKnight, firstBit, secondBit});
-                } else {
-                    u64 testBit = C64(1) << secondBit;
-                    if ((testBit & allWhitePieces.bits) && (testBit ^ whiteCar.bits)) {
-                        moves.moves.push_back(Move{BlackKnight, firstBit, secondBit});
-                    }
-                }
-                attack.bits &= attack.bits - 1;
+        u64 rooks = pieces[Side::rook];
+        while (rooks) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(rooks));
+            rooks &= rooks - 1;
+
+            u64 attack = getRayAttacks<Side::rookForward>(friendly, firstBit);
+            attack |= (getRayAttacks<Side::rookCaptures[0]>(friendly, firstBit)
+                       | getRayAttacks<Side::rookCaptures[1]>(friendly, firstBit)
+                       | getRayAttacks<Side::rookCaptures[2]>(friendly, firstBit)) & sidePieces<Side::opponent>();
+            attack &= ~pieces[Opponent::car];
+
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                moves.moves.push_back(Move{Side::rook, firstBit, secondBit});
+                attack &= attack - 1;
             }
         }
     }
 
-    void addWhiteRookMoves(MoveList &moves) const {
-        BitBoard rooks(whiteRooks);
-        while (rooks.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(rooks.bits));
-            rooks.bits &= rooks.bits - 1;
+    template<PieceRange range>
+    void addBishopMoves(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        const u64 friendly = sidePieces<range>();
 
-            BitBoard attack = getPositiveRayAttacks(allWhitePieces, North, firstBit);
-            attack.bits |= (getPositiveRayAttacks(allWhitePieces, East, firstBit)
-                            | getNegativeRayAttacks(allWhitePieces, West, firstBit)
-                            | getNegativeRayAttacks(allWhitePieces, South, firstBit)) & allBlackPieces.bits;
-            attack.bits &= ~blackCar.bits;
+        u64 bishops = pieces[Side::bishop];
+        while (bishops) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(bishops));
+            bishops &= bishops - 1;
 
+            u64 attack = getRayAttacks<Side::bishopForward[0]>(friendly, firstBit)
+                       | getRayAttacks<Side::bishopForward[1]>(friendly, firstBit);
+            attack |=  ( getRayAttacks<Side::bishopCaptures[0]>(friendly, firstBit)
+                       | getRayAttacks<Side::bishopCaptures[1]>(friendly, firstBit)) & sidePieces<Side::opponent>();
+            attack &= ~pieces[Opponent::car];
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                moves.moves.push_back(Move{WhiteRook, firstBit, secondBit});
-                attack.bits &= attack.bits - 1;
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                moves.moves.push_back(Move{Side::bishop, firstBit, secondBit});
+                attack &= attack - 1;
             }
         }
     }
 
-    void addBlackRookMoves(MoveList &moves) const {
-        BitBoard rooks(blackRooks);
-        while (rooks.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(rooks.bits));
-            rooks.bits &= rooks.bits - 1;
+    // The capture generators below target every enemy piece but the car, in any direction a piece moves
 
-            BitBoard attack = getNegativeRayAttacks(allBlackPieces, South, firstBit);
-            attack.bits |= (getPositiveRayAttacks(allBlackPieces, East, firstBit)
-                            | getNegativeRayAttacks(allBlackPieces, West, firstBit)
-                            | getPositiveRayAttacks(allBlackPieces, North, firstBit)) & allWhitePieces.bits;
-            attack.bits &= ~whiteCar.bits;
+    template<PieceRange range>
+    void addPawnCaptures(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                moves.moves.push_back(Move{BlackRook, firstBit, secondBit});
-                attack.bits &= attack.bits - 1;
-            }
+        const u64 pawns = pieces[Side::pawn];
+        const u64 targets = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
+        u64 pawnBoard;
+
+        pawnBoard = Side::advance(pawns, 9u) & Side::pawnCapture9Mask & targets;
+        while (pawnBoard) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard));
+            moves.moves.push_back(Move{Side::pawn, Side::retreat(firstBit, 9u), firstBit});
+            pawnBoard &= pawnBoard - 1;
+        }
+
+        pawnBoard = Side::advance(pawns, 7u) & Side::pawnCapture7Mask & targets;
+        while (pawnBoard) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(pawnBoard));
+            moves.moves.push_back(Move{Side::pawn, Side::retreat(firstBit, 7u), firstBit});
+            pawnBoard &= pawnBoard - 1;
         }
     }
 
-    void addWhiteBishopMoves(MoveList &moves) const {
-        BitBoard bishops(whiteBishops);
-        while (bishops.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(bishops.bits));
-            bishops.bits &= bishops.bits - 1;
+    template<PieceRange range>
+    void addKnightCaptures(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
 
-            BitBoard attack = getPositiveRayAttacks(allWhitePieces, NorthEast, firstBit)
-                            | getPositiveRayAttacks(allWhitePieces, NorthWest, firstBit);
-            attack.bits |=  ( getNegativeRayAttacks(allWhitePieces, SouthEast, firstBit)
-                            | getNegativeRayAttacks(allWhitePieces, SouthWest, firstBit)) & allBlackPieces.bits;
-            attack.bits &= ~blackCar.bits;
+        const u64 targets = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
 
+        u64 knights = pieces[Side::knight];
+        while (knights) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(knights));
+            knights &= knights - 1;
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                moves.moves.push_back(Move{WhiteBishop, firstBit, secondBit});
-                attack.bits &= attack.bits - 1;
+            u64 attack = knightLookupTable[firstBit] & targets;
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                moves.moves.push_back(Move{Side::knight, firstBit, secondBit});
+                attack &= attack - 1;
             }
         }
     }
 
-    void addBlackBishopMoves(MoveList &moves) const {
-        BitBoard bishops(blackBishops);
-        while (bishops.bits) {
-            auto firstBit = static_cast<u8>(__builtin_ctzll(bishops.bits));
-            bishops.bits &= bishops.bits - 1;
+    template<PieceRange range>
+    void addRookCaptures(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
 
-            BitBoard attack = getNegativeRayAttacks(allBlackPieces, SouthEast, firstBit)
-                            | getNegativeRayAttacks(allBlackPieces, SouthWest, firstBit);
-            attack.bits |=  ( getPositiveRayAttacks(allBlackPieces, NorthEast, firstBit)
-                            | getPositiveRayAttacks(allBlackPieces, NorthWest, firstBit)) & allWhitePieces.bits;
-            attack.bits &= ~whiteCar.bits;
+        const u64 friendly = sidePieces<range>();
+        const u64 targets = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
 
+        u64 rooks = pieces[Side::rook];
+        while (rooks) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(rooks));
+            rooks &= rooks - 1;
 
-            while (attack.bits) {
-                auto secondBit = static_cast<u8>(__builtin_ctzll(attack.bits));
-                moves.moves.push_back(Move{BlackBishop, firstBit, secondBit});
-                attack.bits &= attack.bits - 1;
+            u64 attack = ( getRayAttacks<Side::rookForward>(friendly, firstBit)
+                         | getRayAttacks<Side::rookCaptures[0]>(friendly, firstBit)
+                         | getRayAttacks<Side::rookCaptures[1]>(friendly, firstBit)
+                         | getRayAttacks<Side::rookCaptures[2]>(friendly, firstBit)) & targets;
+
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                moves.moves.push_back(Move{Side::rook, firstBit, secondBit});
+                attack &= attack - 1;
             }
         }
     }
 
-    void addWhiteCarMove(MoveList &moves) const {
-        Move move{WhiteCar, 0, 0};
-        switch(whiteCar.bits) {
-            case C64(0b0000000000000000000000000000000000000000000000000000000000000001):
-                move = Move{WhiteCar, 0, 9};
-                break;
-            case C64(0b0000000000000000000000000000000000000000000000000000001000000000):
-                move = Move{WhiteCar, 9, 18};
-                break;
-            case C64(0b0000000000000000000000000000000000000000000001000000000000000000):
-                move = Move{WhiteCar, 18, 27};
-                break;
-            case C64(0b0000000000000000000000000000000000001000000000000000000000000000):
-                move = Move{WhiteCar, 27, 28};
-                break;
-            case C64(0b0000000000000000000000000000000000010000000000000000000000000000):
-                move = Move{WhiteCar, 28, 29};
-                break;
-            case C64(0b0000000000000000000000000000000000100000000000000000000000000000):
-                move = Move{WhiteCar, 29, 30};
-                break;
-            default:
-                cout << "?? Dude, where's my car ??" << endl;
-        }
-
-        if ((allPieces.bits & pieceLookupTable[move.toCell]) == 0 || moves.moves.empty()) {
-            moves.carIdx = moves.moves.size();
-            moves.moves.push_back(move);
+    template<PieceRange range>
+    void addBishopCaptures(MoveList &moves) const {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        const u64 friendly = sidePieces<range>();
+        const u64 targets = sidePieces<Side::opponent>() & ~pieces[Opponent::car];
+
+        u64 bishops = pieces[Side::bishop];
+        while (bishops) {
+            auto firstBit = static_cast<u8>(__builtin_ctzll(bishops));
+            bishops &= bishops - 1;
+
+            u64 attack = ( getRayAttacks<Side::bishopForward[0]>(friendly, firstBit)
+                         | getRayAttacks<Side::bishopForward[1]>(friendly, firstBit)
+                         | getRayAttacks<Side::bishopCaptures[0]>(friendly, firstBit)
+                         | getRayAttacks<Side::bishopCaptures[1]>(friendly, firstBit)) & targets;
+
+            while (attack) {
+                auto secondBit = static_cast<u8>(__builtin_ctzll(attack));
+                moves.moves.push_back(Move{Side::bishop, firstBit, secondBit});
+                attack &= attack - 1;
+            }
         }
     }
 
-    void addBlackCarMove(MoveList &moves) const {
-        // C++ doesn't support switch-case for values outside the range of an int, so we use if-else instead.
-        Move move{BlackCar, 0, 0};
-        if (blackCar.bits & pieceLookupTable[56]) {
-            move = Move{BlackCar, 56, 49};
-        } else if (blackCar.bits & pieceLookupTable[49]) {
-            move = Move{BlackCar, 49, 42};
-        } else if (blackCar.bits & pieceLookupTable[42]) {
-            move = Move{BlackCar, 42, 35};
-        } else if (blackCar.bits & pieceLookupTable[35]) {
-            move = Move{BlackCar, 35, 36};
-        } else if (blackCar.bits & pieceLookupTable[36]) {
-            move = Move{BlackCar, 36, 37};
-        } else if (blackCar.bits & pieceLookupTable[37]) {
-            move = Move{BlackCar, 37, 38};
-        } else {
+    template<PieceRange range>
+    void addCarMove(MoveList &moves) const {
+        using Side = SideTraits<range>;
+
+        const u64 car = pieces[Side::car];
+        Move move{Side::car, 0, 0};
+        bool found = false;
+        for (int i = 0; i < 6; i++) {
+            if (car == pieceLookupTable[Side::carPath[i]]) {
+                move = Move{Side::car, Side::carPath[i], Side::carPath[i + 1]};
+                found = true;
+            }
+        }
+        if (!found) {
             cout << "?? Dude, where's my car ??" << endl;
         }
 
-        if ((allPieces.bits & pieceLookupTable[move.toCell]) == 0 || moves.moves.empty()) {
+        if ((allPieces & pieceLookupTable[move.toCell]) == 0 || moves.moves.empty()) {
             moves.carIdx = moves.moves.size();
             moves.moves.push_back(move);
         }
     }
-
-    inline u64 getPositiveRayAttacks(BitBoard friendly, ScanDirection direction, u8 square) const {
-        u64 attacks = rayLookupTable[direction][square];
-        u64 blocker = attacks & allPieces.bits;
-        square = static_cast<u8>(__builtin_ctzll(blocker | C64(0x8000000000000000)));
-        u64 friendMask = friendly.bits & pieceLookupTable[square];
-        return attacks ^ rayLookupTable[direction][square] ^ friendMask;
-    }
-
-    inline u64 getNegativeRayAttacks(BitBoard friendly, ScanDirection direction, u8 square) const {
-        u64 attacks = rayLookupTable[direction][square];
-        u64 blocker = attacks & allPieces.bits;
-        square = static_cast<u8>(63 - __builtin_clzll(blocker | C64(1)));
-        u64 friendMask = friendly.bits & pieceLookupTable[square];
-        return attacks ^ rayLookupTable[direction][square] ^ friendMask;
-    }
-
-    BitBoard pieceTypeToBoard(PieceType pieceType) const {
-        switch (pieceType) {
-            case BlackPawn:     return blackPawns;
-            case BlackKnight:   return blackKnights;
-            case BlackRook:     return blackRooks;
-            case BlackBishop:   return blackBishops;
-            case BlackCar:      return blackCar;
-
-            case WhitePawn:     return whitePawns;
-            case WhiteKnight:   return whiteKnights;
-            case WhiteRook:     return whiteRooks;
-            case WhiteBishop:   return whiteBishops;
-            case WhiteCar:      return whiteCar;
-
-            default:
-                cout << "Invalid board lookup from pieceType" << endl;
-                return {};
-        }
-    }
 };
 
+static_assert(std::is_trivially_copyable<Board>::value, "Board copies must stay plain memory copies");
+
 static const bool CAR_SQUARES[8][7] = {
         {true , false, false, false, false, false, false},
         {false, true , false, false, false, false, false},
@@ -476,6 +653,9 @@ static const bool CAR_SQUARES[8][7] = {
         {true , false, false, false, false, false, false},
 };
 
+// Indexed by PieceType: computer (black) pieces are upper-case and player (white) pieces lower-case
+static const char PIECE_CHARS[] = ".PNRBCpnrbc";
+
 std::ostream& operator<<(std::ostream &stream, const Board &board) {
     bool blueBG = true;
 
@@ -487,21 +667,11 @@ std::ostream& operator<<(std::ostream &stream, const Board &board) {
         for (int x = 0; x < 7; x++) {
             int bgColor = CAR_SQUARES[y][x]? RED : (blueBG? BLUE : BLACK);
 
-            if (board.allPieces.isBitSet(x, y)) {
-                if (board.allWhitePieces.isBitSet(x, y)) {
-                    setColor(stream, BRIGHT, WHITE, bgColor);
-                    if (board.whitePawns.isBitSet(x, y))    stream << " p ";
-                    if (board.whiteRooks.isBitSet(x, y))    stream << " r ";
-                    if (board.whiteKnights.isBitSet(x, y))  stream << " n ";
-                    if (board.whiteBishops.isBitSet(x, y))  stream << " b ";
-                    if (board.whiteCar.isBitSet(x, y))      stream << " c ";
-                } else {
-                    setColor(stream, BRIGHT, GREEN, bgColor);
-                    if (board.blackPawns.isBitSet(x, y))    stream << " P ";
-                    if (board.blackRooks.isBitSet(x, y))    stream << " R ";
-                    if (board.blackKnights.isBitSet(x, y))  stream << " N ";
-                    if (board.blackBishops.isBitSet(x, y))  stream << " B ";
-                    if (board.blackCar.isBitSet(x, y))      stream << " C ";
+            if (BitBoard(board.allPieces).isBitSet(x, y)) {
+                bool isWhite = BitBoard(board.sidePieces<PieceRange::White>()).isBitSet(x, y);
+                setColor(stream, BRIGHT, isWhite? WHITE : GREEN, bgColor);
+                for (int i = 1; i <= 10; i++) {
+                    if (board.isBitSet(static_cast<PieceType>(i), x, y)) stream << ' ' << PIECE_CHARS[i] << ' ';
                 }
             } else {
                 setColor(stream, BRIGHT, WHITE, bgColor);
@@ -522,3 +692,64 @@ std::ostream& operator<<(std::ostream &stream, const Board &board) {
     return stream;
 }
 
+
+// Positions are written rank 8 to rank 1, seven files per rank separated by '/', followed by the side to move.
+// Pieces use the PIECE_CHARS letters, matching the board printout:
+//   "C....../.P...../RRPBB../NN.PPPP/nn.pppp/rrpbb../.p...../c...... w"
+std::string boardToString(const Board &board, PieceRange range) {
+    std::string text;
+
+    for (int y = 0; y < 8; y++) {
+        if (y > 0) text += '/';
+
+        for (int x = 0; x < 7; x++) {
+            char cell = PIECE_CHARS[EmptyPiece];
+            for (int i = 1; i <= 10; i++) {
+                if (board.isBitSet(static_cast<PieceType>(i), x, y)) cell = PIECE_CHARS[i];
+            }
+            text += cell;
+        }
+    }
+
+    text += range == PieceRange::White? " w" : " b";
+    return text;
+}
+
+bool parseBoard(const std::string &text, Board &board, PieceRange &range) {
+    Board parsed;
+    parsed.clear();
+
+    int x = 0, y = 0;
+    size_t i = 0;
+    for (; i < text.size() && text[i] != ' '; i++) {
+        char cell = text[i];
+        if (cell == '/') {
+            if (x != 7) return false;
+            x = 0;
+            y++;
+            continue;
+        }
+        if (x >= 7 || y >= 8) return false;
+
+        if (cell != PIECE_CHARS[EmptyPiece]) {
+            int pieceType = 1;
+            while (pieceType <= 10 && PIECE_CHARS[pieceType] != cell) pieceType++;
+            if (pieceType > 10) return false;
+            parsed.flipBit(static_cast<PieceType>(pieceType), x, y);
+        }
+        x++;
+    }
+
+    if (x != 7 || y != 7 || i + 1 >= text.size()) return false;
+    if (text[i + 1] == 'w') {
+        range = PieceRange::White;
+    } else if (text[i + 1] == 'b') {
+        range = PieceRange::Black;
+    } else {
+        return false;
+    }
+
+    parsed.updatePieceAggregates();
+    board = parsed;
+    return true;
+}
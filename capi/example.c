@@ -0,0 +1,74 @@
+#include <stdio.h>
+
+#include "phantomracer.h"
+
+/* Plays a short game through the C API against itself and checks the results along the way. Built as
+ * a test so that the header keeps compiling as C and the library keeps linking from C. */
+
+#define CHECK(condition) do { if (!(condition)) { printf("Check failed: %s (line %d)\n", #condition, __LINE__); return 1; } } while (0)
+
+int main(void) {
+    pr_position* position = pr_position_create(PR_WHITE);
+    CHECK(position != NULL);
+    CHECK(pr_side_to_move(position) == PR_WHITE);
+
+    char text[66];
+    CHECK(pr_position_to_string(position, text, sizeof(text)) == PR_OK);
+    CHECK(pr_position_to_string(position, text, 10) == PR_ERROR_BUFFER_TOO_SMALL);
+
+    pr_position* parsed = pr_position_from_string(text);
+    CHECK(parsed != NULL);
+    CHECK(pr_position_from_string("not a board") == NULL);
+
+    pr_move moves[PR_MAX_MOVES];
+    int count = pr_generate_moves(position, moves, PR_MAX_MOVES);
+    CHECK(count > 0);
+    CHECK(pr_generate_moves(position, moves, 2) == count);
+
+    pr_move bogus = {0, 0, 0};
+    CHECK(pr_apply_move(position, bogus) == PR_ERROR_ILLEGAL_MOVE);
+
+    pr_search_limits limits = {0, 4};
+    pr_search_result result;
+    CHECK(pr_search(position, &limits, &result) == PR_OK);
+    CHECK(result.depth == 4);
+    CHECK(pr_apply_move(position, result.best_move) == PR_OK);
+    CHECK(pr_side_to_move(position) == PR_BLACK);
+
+    /* The best line of an analysis scores the same as a plain search */
+    pr_analysis_line lines[3];
+    limits.max_depth = 4;
+    CHECK(pr_analyse(position, &limits, lines, 3) == 3);
+    CHECK(pr_search(position, &limits, &result) == PR_OK);
+    CHECK(lines[0].score == result.score);
+    CHECK(lines[0].score >= lines[1].score && lines[1].score >= lines[2].score);
+    CHECK(lines[0].length >= 1 && lines[0].depth == 4);
+
+    /* Play on with short timed searches until the game ends */
+    limits.time_ms = 20;
+    limits.max_depth = 0;
+    int plies = 1;
+    while (pr_game_state(position) == PR_PLAYING && plies < 200) {
+        CHECK(pr_search(position, &limits, &result) == PR_OK);
+        CHECK(pr_apply_move(position, result.best_move) == PR_OK);
+        plies++;
+    }
+    CHECK(pr_game_state(position) != PR_PLAYING);
+    CHECK(pr_generate_moves(position, moves, PR_MAX_MOVES) == 0);
+    CHECK(pr_search(position, &limits, &result) == PR_ERROR_GAME_OVER);
+
+    const pr_position* batch[2] = {parsed, position};
+    int32_t scores[2];
+    CHECK(pr_evaluate_batch(batch, 2, scores) == PR_OK);
+    CHECK(scores[0] == 0);
+
+    char moveText[5];
+    CHECK(pr_move_to_string(result.best_move, NULL, sizeof(moveText)) == PR_ERROR_INVALID_ARGUMENT);
+    CHECK(pr_move_to_string(result.best_move, moveText, 4) == PR_ERROR_BUFFER_TOO_SMALL);
+    CHECK(pr_move_to_string(result.best_move, moveText, sizeof(moveText)) == PR_OK);
+    printf("Game over after %d plies with %s, %s won\n", plies, moveText, pr_game_state(position) == PR_BLACK_WINS? "black" : "white");
+
+    pr_position_destroy(parsed);
+    pr_position_destroy(position);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "phantomracer.h"
+
+#include "../bitboard.h"
+#include "../board.h"
+#include "../move.h"
+#include "../strategy/minimax.h"
+
+// The engine is header-only, so the whole library is this one translation unit and nothing but the
+// C functions below is exported.
+
+struct pr_position {
+    Board board;
+    PieceRange toMove;
+};
+
+static void ensureInitialised() {
+    static std::once_flag initialised;
+    std::call_once(initialised, initAll);
+}
+
+static PieceRange toRange(pr_side side) {
+    return side == PR_BLACK? PieceRange::Black : PieceRange::White;
+}
+
+static pr_move toCMove(const Move &move) {
+    return pr_move{static_cast<uint8_t>(move.movingPiece), static_cast<uint8_t>(move.fromCell), static_cast<uint8_t>(move.toCell)};
+}
+
+pr_position* pr_position_create(pr_side side) {
+    ensureInitialised();
+    return new(std::nothrow) pr_position{Board(), toRange(side)};
+}
+
+pr_position* pr_position_from_string(const char* text) {
+    ensureInitialised();
+    if (!text) return nullptr;
+
+    Board board;
+    PieceRange range;
+    if (!parseBoard(text, board, range)) return nullptr;
+    return new(std::nothrow) pr_position{board, range};
+}
+
+pr_position* pr_position_copy(const pr_position* position) {
+    if (!position) return nullptr;
+    return new(std::nothrow) pr_position(*position);
+}
+
+void pr_position_destroy(pr_position* position) {
+    delete position;
+}
+
+int pr_position_to_string(const pr_position* position, char* buffer, size_t size) {
+    if (!position || !buffer) return PR_ERROR_INVALID_ARGUMENT;
+
+    std::string text = boardToString(position->board, position->toMove);
+    if (text.size() + 1 > size) return PR_ERROR_BUFFER_TOO_SMALL;
+
+    memcpy(buffer, text.c_str(), text.size() + 1);
+    return PR_OK;
+}
+
+pr_side pr_side_to_move(const pr_position* position) {
+    return position && position->toMove == PieceRange::Black? PR_BLACK : PR_WHITE;
+}
+
+pr_state pr_game_state(const pr_position* position) {
+    if (!position) return PR_PLAYING;
+
+    switch (position->board.getGameState()) {
+        case GameState::BlackWins: return PR_BLACK_WINS;
+        case GameState::WhiteWins: return PR_WHITE_WINS;
+        default: return PR_PLAYING;
+    }
+}
+
+int pr_generate_moves(const pr_position* position, pr_move* buffer, size_t capacity) {
+    if (!position || (!buffer && capacity > 0)) return PR_ERROR_INVALID_ARGUMENT;
+    if (position->board.getGameState() != GameState::IsPlaying) return 0;
+
+    auto moves = position->board.getValidMoves(position->toMove);
+    for (size_t i = 0; i < moves.size() && i < capacity; i++) {
+        buffer[i] = toCMove(moves[i]);
+    }
+    return static_cast<int>(moves.size());
+}
+
+int pr_apply_move(pr_position* position, pr_move move) {
+    if (!position) return PR_ERROR_INVALID_ARGUMENT;
+    if (position->board.getGameState() != GameState::IsPlaying) return PR_ERROR_GAME_OVER;
+
+    auto moves = position->board.getValidMoves(position->toMove);
+    for (auto legalMove : moves.moves) {
+        if (legalMove.fromCell == move.from && legalMove.toCell == move.to) {
+            position->board.performMove(position->toMove, legalMove);
+            position->toMove = opponentOf(position->toMove);
+            return PR_OK;
+        }
+    }
+    return PR_ERROR_ILLEGAL_MOVE;
+}
+
+int pr_move_to_string(pr_move move, char* buffer, size_t size) {
+    if (!buffer) return PR_ERROR_INVALID_ARGUMENT;
+    if (size < 5) return PR_ERROR_BUFFER_TOO_SMALL;
+
+    buffer[0] = static_cast<char>('A' + move.from % 8);
+    buffer[1] = static_cast<char>('1' + move.from / 8);
+    buffer[2] = static_cast<char>('A' + move.to % 8);
+    buffer[3] = static_cast<char>('1' + move.to / 8);
+    buffer[4] = '\0';
+    return PR_OK;
+}
+
+int pr_open_transposition_file(const char* path, unsigned table_bits) {
+    ensureInitialised();
+    if (!path || table_bits < 1 || table_bits >= 40) return PR_ERROR_INVALID_ARGUMENT;
+    return openTableFile(path, table_bits)? PR_OK : PR_ERROR_IO;
+}
+
+int pr_search(const pr_position* position, const pr_search_limits* limits, pr_search_result* result) {
+    if (!position || !limits || !result || (limits->time_ms == 0 && limits->max_depth == 0)) return PR_ERROR_INVALID_ARGUMENT;
+    if (position->board.getGameState() != GameState::IsPlaying) return PR_ERROR_GAME_OVER;
+
+    SearchContext context;
+    context.verbose = false;
+    if (limits->time_ms > 0) {
+        context.setDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(limits->time_ms));
+    }
+
+    // The search starts at depth 2 and the table has room for depths up to 255
+    int maxDepth = limits->max_depth > 0? static_cast<int>(std::min<uint32_t>(std::max<uint32_t>(limits->max_depth, 2), 64)) : 64;
+
+    // Lets the table tell this search's entries from those of earlier calls, as the game does
+    transpositionTable.newSearch();
+    auto moves = position->board.getValidMoves(position->toMove);
+    SearchResult search = position->toMove == PieceRange::Black
+                        ? searchRoot<PieceRange::Black>(context, position->board, moves, maxDepth)
+                        : searchRoot<PieceRange::White>(context, position->board, moves, maxDepth);
+
+    result->best_move = toCMove(search.bestMove);
+    result->score = position->toMove == PieceRange::Black? search.score : -search.score;
+    result->depth = search.depth;
+    result->nodes = context.nodesEvaluated;
+    return PR_OK;
+}
+
+int pr_analyse(const pr_position* position, const pr_search_limits* limits, pr_analysis_line* lines, size_t count) {
+    if (!position || !limits || !lines || count == 0 || (limits->time_ms == 0 && limits->max_depth == 0)) return PR_ERROR_INVALID_ARGUMENT;
+    if (position->board.getGameState() != GameState::IsPlaying) return PR_ERROR_GAME_OVER;
+
+    SearchContext context;
+    context.verbose = false;
+    if (limits->time_ms > 0) {
+        context.setDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(limits->time_ms));
+    }
+    int maxDepth = limits->max_depth > 0? static_cast<int>(std::min<uint32_t>(std::max<uint32_t>(limits->max_depth, 2), 64)) : 64;
+
+    transpositionTable.newSearch();
+    auto moves = position->board.getValidMoves(position->toMove);
+    SearchResult search = position->toMove == PieceRange::Black
+                        ? searchMultiPv<PieceRange::Black>(context, position->board, moves, count, maxDepth)
+                        : searchMultiPv<PieceRange::White>(context, position->board, moves, count, maxDepth);
+
+    for (size_t i = 0; i < search.lines.size(); i++) {
+        const PvLine &line = search.lines[i];
+        lines[i].length = static_cast<uint32_t>(std::min<size_t>(line.pv.size(), PR_MAX_VARIATION));
+        for (uint32_t j = 0; j < lines[i].length; j++) lines[i].moves[j] = toCMove(line.pv[j]);
+        lines[i].score = position->toMove == PieceRange::Black? line.score : -line.score;
+        lines[i].depth = search.depth;
+    }
+    return static_cast<int>(search.lines.size());
+}
+
+int pr_evaluate_batch(const pr_position* const* positions, size_t count, int32_t* scores) {
+    if ((!positions || !scores) && count > 0) return PR_ERROR_INVALID_ARGUMENT;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!positions[i]) return PR_ERROR_INVALID_ARGUMENT;
+
+        int score = heuristic(positions[i]->board);
+        scores[i] = positions[i]->toMove == PieceRange::Black? score : -score;
+    }
+    return PR_OK;
+}
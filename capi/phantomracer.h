@@ -0,0 +1,120 @@
+#ifndef PHANTOMRACER_H
+#define PHANTOMRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C API for embedding the engine, built as libphantomracer (static and shared).
+ *
+ * Positions are opaque handles that own their board and side to move. Squares are numbered rank * 8 + file
+ * from A1 = 0; only files A-G exist. Functions returning int return PR_OK or a negative PR_ERROR_* code
+ * unless documented otherwise. Different positions may be used from different threads at once.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define PR_API __attribute__((visibility("default")))
+#else
+#define PR_API
+#endif
+
+#define PR_OK 0
+#define PR_ERROR_INVALID_ARGUMENT (-1)
+#define PR_ERROR_ILLEGAL_MOVE (-2)
+#define PR_ERROR_BUFFER_TOO_SMALL (-3)
+#define PR_ERROR_GAME_OVER (-4)
+#define PR_ERROR_IO (-5)
+
+/* Enough for every move of any position */
+#define PR_MAX_MOVES 256
+
+typedef struct pr_position pr_position;
+
+typedef enum pr_side {
+    PR_WHITE = 0,
+    PR_BLACK = 1
+} pr_side;
+
+typedef enum pr_state {
+    PR_PLAYING = 0,
+    PR_BLACK_WINS = 1,
+    PR_WHITE_WINS = 2
+} pr_state;
+
+typedef struct pr_move {
+    uint8_t piece;      /* 1-5 black pawn, knight, rook, bishop, car; 6-10 the same for white */
+    uint8_t from;
+    uint8_t to;
+} pr_move;
+
+typedef struct pr_search_limits {
+    uint32_t time_ms;   /* 0 for no time limit */
+    uint32_t max_depth; /* 0 for no depth limit; at least one of the two must be set */
+} pr_search_limits;
+
+typedef struct pr_search_result {
+    pr_move best_move;
+    int32_t score;      /* From the point of view of the side to move */
+    int32_t depth;      /* Deepest iteration that completed */
+    uint64_t nodes;
+} pr_search_result;
+
+/* Longest variation reported by pr_analyse */
+#define PR_MAX_VARIATION 64
+
+typedef struct pr_analysis_line {
+    pr_move moves[PR_MAX_VARIATION];    /* The root move, then the expected replies */
+    uint32_t length;
+    int32_t score;      /* From the point of view of the side to move */
+    int32_t depth;      /* Deepest iteration that completed */
+} pr_analysis_line;
+
+/* The starting position with `side` to move, or NULL if out of memory */
+PR_API pr_position* pr_position_create(pr_side side);
+
+/* Parses the board notation written by pr_position_to_string, e.g. "C....../.P...../RRPBB../NN.PPPP/nn.pppp/rrpbb../.p...../c...... w" */
+PR_API pr_position* pr_position_from_string(const char* text);
+
+PR_API pr_position* pr_position_copy(const pr_position* position);
+
+PR_API void pr_position_destroy(pr_position* position);
+
+/* Writes the board notation and a terminating zero; needs 66 bytes */
+PR_API int pr_position_to_string(const pr_position* position, char* buffer, size_t size);
+
+PR_API pr_side pr_side_to_move(const pr_position* position);
+
+PR_API pr_state pr_game_state(const pr_position* position);
+
+/* Writes up to `capacity` legal moves and returns how many there are in total, like snprintf */
+PR_API int pr_generate_moves(const pr_position* position, pr_move* buffer, size_t capacity);
+
+/* Plays a legal move for the side to move; only `from` and `to` are looked at */
+PR_API int pr_apply_move(pr_position* position, pr_move move);
+
+/* Writes e.g. "A2A3" and a terminating zero into `buffer`, which must hold at least 5 bytes */
+PR_API int pr_move_to_string(pr_move move, char* buffer, size_t size);
+
+/* Moves the transposition table used by every search into the file at `path`, where it is shared with
+ * other processes using the same file and survives restarts. Call before any search; a new file gets
+ * 2^table_bits entries, and so does a file written by a build that evaluates positions differently. */
+PR_API int pr_open_transposition_file(const char* path, unsigned table_bits);
+
+PR_API int pr_search(const pr_position* position, const pr_search_limits* limits, pr_search_result* result);
+
+/* Like pr_search, but finds the best `count` root moves, each with its exact score and variation, in one
+ * search. Writes them best first and returns how many it wrote, which is fewer if there are fewer moves. */
+PR_API int pr_analyse(const pr_position* position, const pr_search_limits* limits, pr_analysis_line* lines, size_t count);
+
+/* Static evaluation of `count` positions, each from the point of view of its side to move */
+PR_API int pr_evaluate_batch(const pr_position* const* positions, size_t count, int32_t* scores);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
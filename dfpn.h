@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "types.h"
+#include "game.h"
+#include "board.h"
+#include "move.h"
+#include "side.h"
+
+// Depth-first proof-number search (df-pn) for proving car races. Every quiet move in this game goes
+// forward and every capture removes a piece, so the game graph has no cycles and plain df-pn with a
+// transposition table is sound.
+//
+// Proof and disproof numbers are kept from the point of view of the side to move at each node:
+// phi is the proof number for that side and delta its disproof number, so a node's phi is the smallest
+// delta among its children and its delta is the sum of its children's phi. That also makes them the same
+// for a position and its mirror image with the other side to move, so both share one table entry.
+
+enum class DfpnOutcome {
+    Unknown,
+    Win,
+    Loss,
+};
+
+struct DfpnResult {
+    DfpnOutcome outcome = DfpnOutcome::Unknown;
+    std::vector<Move> line;     // Proven line from the root, which may be cut short by table replacement
+    u64 nodes = 0;
+};
+
+class DfpnSolver {
+public:
+    static const u32 INFINITE = 1u << 30;
+
+    explicit DfpnSolver(unsigned tableBits = 18) : table(static_cast<size_t>(1) << tableBits), mask(table.size() - 1) {}
+
+    void clear() {
+        std::fill(table.begin(), table.end(), Entry{});
+    }
+
+    DfpnResult solve(const Board &board, PieceRange range, u64 nodeBudget) {
+        nodes = 0;
+        budget = nodeBudget;
+
+        DfpnResult result;
+        u32 phi, delta;
+        if (range == PieceRange::White) {
+            mid<PieceRange::White>(board, INFINITE - 1, INFINITE - 1);
+            lookup<PieceRange::White>(board, phi, delta);
+        } else {
+            mid<PieceRange::Black>(board, INFINITE - 1, INFINITE - 1);
+            lookup<PieceRange::Black>(board, phi, delta);
+        }
+
+        result.nodes = nodes;
+        if (phi == 0) {
+            result.outcome = DfpnOutcome::Win;
+        } else if (delta == 0) {
+            result.outcome = DfpnOutcome::Loss;
+        }
+
+        if (result.outcome != DfpnOutcome::Unknown) {
+            extractLine(board, range, result.line);
+        }
+
+        return result;
+    }
+
+    // The move df-pn considers most promising at the root after the last solve(), for use when unproven
+    Move mostProvingMove(const Board &board, PieceRange range) {
+        if (range == PieceRange::White) return mostProvingMove<PieceRange::White>(board);
+        return mostProvingMove<PieceRange::Black>(board);
+    }
+
+private:
+    struct Entry {
+        u64 key = 0;
+        u32 phi = 0;
+        u32 delta = 0;
+    };
+
+    std::vector<Entry> table;
+    size_t mask;
+    u64 nodes = 0;
+    u64 budget = 0;
+
+    static u32 saturatingAdd(u32 a, u32 b) {
+        return std::min(a + b, INFINITE);
+    }
+
+    // Looks up a node, falling back to terminal values or an initial estimate: one move may be enough to
+    // prove a win, while disproving it means refuting every move.
+    template<PieceRange range>
+    bool lookup(const Board &board, u32 &phi, u32 &delta) const {
+        GameState state = board.getGameState();
+        if (unlikely(state != GameState::IsPlaying)) {
+            bool won = (state == GameState::WhiteWins) == (range == PieceRange::White);
+            phi = won? 0 : INFINITE;
+            delta = won? INFINITE : 0;
+            return true;
+        }
+
+        u64 key = board.canonicalHash(range);
+        const Entry &entry = table[key & mask];
+        if (entry.key == key) {
+            phi = entry.phi;
+            delta = entry.delta;
+            return true;
+        }
+
+        phi = 1;
+        delta = static_cast<u32>(std::max(1, board.countMoves<range>()));
+        return false;
+    }
+
+    template<PieceRange range>
+    void store(const Board &board, u32 phi, u32 delta) {
+        u64 key = board.canonicalHash(range);
+        table[key & mask] = Entry{key, phi, delta};
+    }
+
+    template<PieceRange range>
+    void mid(const Board &board, u32 thresholdPhi, u32 thresholdDelta) {
+        constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+        nodes++;
+
+        u32 phi, delta;
+        lookup<range>(board, phi, delta);
+        if (board.getGameState() != GameState::IsPlaying || phi >= thresholdPhi || delta >= thresholdDelta) {
+            return;
+        }
+
+        auto moves = board.getValidMoves<range>();
+        std::vector<Board> children(moves.size(), board);
+        for (size_t i = 0; i < moves.size(); i++) {
+            children[i].performMove<range>(moves[i]);
+        }
+
+        while (true) {
+            // Children are seen from the opponent's side: their delta proves this node, their phi disproves it
+            size_t bestIdx = 0;
+            u32 bestDelta = INFINITE, secondDelta = INFINITE, bestPhi = INFINITE;
+            phi = INFINITE;
+            delta = 0;
+
+            for (size_t i = 0; i < children.size(); i++) {
+                u32 childPhi, childDelta;
+                lookup<opponent>(children[i], childPhi, childDelta);
+
+                delta = saturatingAdd(delta, childPhi);
+                if (childDelta < bestDelta) {
+                    secondDelta = bestDelta;
+                    bestDelta = childDelta;
+                    bestPhi = childPhi;
+                    bestIdx = i;
+                } else if (childDelta < secondDelta) {
+                    secondDelta = childDelta;
+                }
+            }
+            phi = bestDelta;
+
+            if (phi >= thresholdPhi || delta >= thresholdDelta || nodes >= budget) {
+                store<range>(board, phi, delta);
+                return;
+            }
+
+            u32 childThresholdPhi = saturatingAdd(thresholdDelta - delta, bestPhi);
+            u32 childThresholdDelta = std::min(thresholdPhi, saturatingAdd(secondDelta, 1));
+            mid<opponent>(children[bestIdx], childThresholdPhi, childThresholdDelta);
+        }
+    }
+
+    template<PieceRange range>
+    Move mostProvingMove(const Board &board) {
+        constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+        auto moves = board.getValidMoves<range>();
+        Move bestMove = moves[0];
+        u32 bestDelta = INFINITE + 1;
+        for (auto move : moves.moves) {
+            Board child(board);
+            child.performMove<range>(move);
+
+            u32 childPhi, childDelta;
+            lookup<opponent>(child, childPhi, childDelta);
+            if (childDelta < bestDelta) {
+                bestDelta = childDelta;
+                bestMove = move;
+            }
+        }
+
+        return bestMove;
+    }
+
+    // Follows proven entries from the root. The line stops early if an entry on it has been overwritten.
+    void extractLine(const Board &board, PieceRange range, std::vector<Move> &line) {
+        Board current(board);
+
+        while (current.getGameState() == GameState::IsPlaying && line.size() < 128) {
+            u32 phi, delta;
+            bool known = range == PieceRange::White? lookup<PieceRange::White>(current, phi, delta)
+                                                   : lookup<PieceRange::Black>(current, phi, delta);
+            if (!known || (phi != 0 && delta != 0)) break;
+
+            // A winning side plays a child that is lost for the opponent; a losing side has only won children
+            auto moves = current.getValidMoves(range);
+            PieceRange opponent = opponentOf(range);
+            bool found = false;
+            Move chosen = moves[0];
+            for (auto move : moves.moves) {
+                Board child(current);
+                child.performMove(range, move);
+
+                u32 childPhi, childDelta;
+                if (opponent == PieceRange::White) lookup<PieceRange::White>(child, childPhi, childDelta);
+                else lookup<PieceRange::Black>(child, childPhi, childDelta);
+
+                if ((phi == 0 && childDelta == 0) || (delta == 0 && childPhi == 0)) {
+                    chosen = move;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) break;
+
+            line.push_back(chosen);
+            current.performMove(range, chosen);
+            range = opponent;
+        }
+    }
+};
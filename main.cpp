@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 
 #include "bitboard.h"
@@ -6,35 +7,125 @@
 #include "test.h"
 #include "board.h"
 #include "move.h"
+#include "rng.h"
 
 // Strategies available: random, minimax, mcts
+#if STRATEGY_MCTS
+#include "strategy/mcts.h"
+#else
 #include "strategy/minimax.h"
+#endif
+
+#include "server/client.h"
+#include "bench/signature.h"
+
+// Only the minimax strategy can ponder
+#ifndef PONDERING
+#define PONDERING false
+#endif
 
 using std::cin;
 using std::cout;
 using std::endl;
 using std::flush;
 
-void gameMain();
+void gameMain(RemoteEngine *remote);
 Move getPlayerMove(const MoveList &moves);
 
-int main() {
+// With --connect the computer's moves come from a phantomracer_server instead of a local search, with
+// --tt-file the local search keeps its transposition table in that file from one game to the next, and
+// with --nnue it evaluates positions with the network in that file (see nnue.h). --trace records the
+// computer's searches into a file for phantomracer_trace (see trace.h) and --seed replays the random
+// choices of an earlier game, whose seed it logged. `bench` runs the search benchmark in
+// bench/signature.h instead of a game, and `analyse` prints the best lines of a position.
+int main(int argc, char** argv) {
 #if TESTING
-    testingMain();
+    (void) argc;
+    (void) argv;
+    return testingMain();
 #else
-    gameMain();
+    initAll();
+
+    if (argc >= 2 && !strcmp(argv[1], "bench")) {
+        return runSearchBench(argc >= 3? std::max(2, atoi(argv[2])) : BENCH_DEPTH);
+    }
+#if !STRATEGY_MCTS
+    if (argc >= 3 && !strcmp(argv[1], "analyse")) {
+        return analysePosition(argv[2], argc >= 4? std::max(1, atoi(argv[3])) : ANALYSIS_LINES,
+                               argc >= 5? std::max(2, std::min(64, atoi(argv[4]))) : 0);
+    }
+#endif
+
+    const char* serverAddress = nullptr;
+#ifdef TT_FILE_BITS
+    const char* tableFile = nullptr;
+#endif
+    u64 seed = freshSeed();
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--connect") && i + 1 < argc) {
+            serverAddress = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+#ifdef TT_FILE_BITS
+        } else if (!strcmp(argv[i], "--tt-file") && i + 1 < argc) {
+            tableFile = argv[++i];
+#endif
+#if SEARCH_TRACE
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            if (!searchTrace.open(argv[++i])) {
+                cout << "Could not create " << argv[i] << ", not tracing." << endl;
+            }
+#endif
+        } else if (!strcmp(argv[i], "--nnue") && i + 1 < argc) {
+            if (!loadNnue(argv[++i])) {
+                cout << "Could not load a network from " << argv[i] << ", using the built-in evaluation." << endl;
+            }
+        } else {
+            cout << "Usage: " << argv[0] << " [--connect ADDRESS] [--tt-file PATH] [--nnue PATH] [--trace PATH] [--seed N]" << endl;
+            cout << "       " << argv[0] << " bench [DEPTH]" << endl;
+            cout << "       " << argv[0] << " analyse POSITION [LINES] [DEPTH]" << endl;
+            return 1;
+        }
+    }
+
+#ifdef TT_FILE_BITS
+    // Opened once any network is loaded, since the scores in the file have to come from the same one
+    if (tableFile && !openTableFile(tableFile, TT_FILE_BITS)) {
+        cout << "Could not open " << tableFile << ", using a fresh table." << endl;
+    }
 #endif
+
+    seedRandom(seed);
+    if (serverAddress) {
+        RemoteEngine remote;
+        if (!remote.connectTo(serverAddress)) {
+            cout << "Could not connect to " << serverAddress << endl;
+            return 1;
+        }
+        gameMain(&remote);
+    } else {
+        gameMain(nullptr);
+    }
     return 0;
+#endif
 }
 
-void gameMain() {
-    initAll();
-
+void gameMain(RemoteEngine *remote) {
     showIntroText();
 
     Board board;
     PieceRange currentPlayer = getStartingParticipant();
+#if PONDERING
+    Ponderer ponderer;
+#endif
+
+    if (remote && !remote->setPosition(board, currentPlayer)) {
+        cout << "The server did not accept the game." << endl;
+        return;
+    }
 
+    // Logged so that a game can be replayed with the same random choices
+    cout << endl << "Game seed: " << randomSeed() << endl;
     cout << endl << "Welcome! Here's a new board:" << endl;
     while (true) {
         auto moves = board.getValidMoves(currentPlayer);
@@ -49,12 +140,33 @@ void gameMain() {
 
         Move move{PieceType::EmptyPiece, 0, 0};
         if (currentPlayer == PieceRange::Black) {
-            move = getComputerMove(board, moves);
-            board.performBlackMove(move);
+            if (remote) {
+                if (!remote->computeMove(moves, move)) {
+                    cout << "Lost the connection to the server." << endl;
+                    return;
+                }
+            } else {
+#if PONDERING
+                if (!ponderer.takeReply(move)) move = getComputerMove(board, moves);
+#else
+                move = getComputerMove(board, moves);
+#endif
+            }
+            board.performMove<PieceRange::Black>(move);
             currentPlayer = PieceRange::White;
+#if PONDERING
+            if (!remote) ponderer.start(board);
+#endif
         } else {
             move = getPlayerMove(moves);
-            board.performWhiteMove(move);
+#if PONDERING
+            ponderer.finish(move);
+#endif
+            if (remote && !remote->playMove(move)) {
+                cout << "Lost the connection to the server." << endl;
+                return;
+            }
+            board.performMove<PieceRange::White>(move);
             currentPlayer = PieceRange::Black;
         }
 
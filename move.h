@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
 #include "types.h"
 #include "bitboard.h"
+#include "game.h"
 
 class Move {
 public:
@@ -13,6 +19,11 @@ public:
         return Move{movingPiece, inverseShift(fromCell), inverseShift(toCell)};
     }
 
+    // The same move in the mirrored position, where ranks are flipped and colours swapped
+    Move mirror() const {
+        return Move{mirrorPiece(movingPiece), inverseShift(fromCell), inverseShift(toCell)};
+    }
+
     PieceRange moveRange() const {
         switch (movingPiece) {
             case PieceType::WhitePawn:
@@ -63,6 +74,9 @@ public:
     u64 carIdx = 0;
 
     MoveList(std::vector<Move> moveList) : moves(moveList) {}
+
+    size_t size() const { return moves.size(); }
+    const Move& operator[](size_t idx) const { return moves[idx]; }
 };
 
 std::ostream& operator<<(std::ostream &stream, const Move &move) {
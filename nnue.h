@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Optional neural evaluation in the style of NNUE. The inputs are one feature per piece type and square,
+// so the first layer is just the sum of the weight columns of the pieces on the board. The search keeps
+// that sum, the accumulator, for every ply of its line and updates it per move by subtracting and adding
+// a few columns, which is what makes the network cheap enough to call at every leaf. The accumulator is clipped to 0-127 as
+// bytes and a single int8 dot product gives the score, in the same units as heuristic().
+//
+// Nothing changes until loadNnue() succeeds; the network file is, in little-endian order:
+//   char magic[8] "PRNNUE", u32 version, u32 hidden size,
+//   i16 feature weights [640][hidden], i16 feature biases [hidden], i8 output weights [hidden], i32 output bias
+// and must be loaded before a search starts.
+
+#define NNUE true
+#define NNUE_FILE_VERSION 1
+#define NNUE_HIDDEN 32
+#define NNUE_FEATURES (10 * 64)
+
+// The output sum is divided by 2^NNUE_OUTPUT_SHIFT to give heuristic() units
+#define NNUE_OUTPUT_SHIFT 4
+
+static_assert(NNUE_HIDDEN % 32 == 0, "The output layer works on 32 activations at a time");
+
+struct NnueNetwork {
+    alignas(32) int16_t featureWeights[NNUE_FEATURES][NNUE_HIDDEN];
+    alignas(32) int16_t featureBiases[NNUE_HIDDEN];
+    alignas(32) int8_t outputWeights[NNUE_HIDDEN];
+    int32_t outputBias;
+};
+
+static NnueNetwork nnueNetwork;
+static bool nnueLoaded = false;
+
+inline const int16_t* nnueColumn(int piece, int square) {
+    return nnueNetwork.featureWeights[(piece - 1) * 64 + square];
+}
+
+// The plain loops below compile to a couple of AVX2 adds per column
+struct NnueAccumulator {
+    alignas(32) int16_t values[NNUE_HIDDEN] = {};
+
+    void refresh(const u64 (&pieces)[11]) {
+        memcpy(values, nnueNetwork.featureBiases, sizeof(values));
+        for (int piece = 1; piece <= 10; piece++) {
+            u64 bits = pieces[piece];
+            while (bits) {
+                add(piece, __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    void add(int piece, int square) {
+        const int16_t* column = nnueColumn(piece, square);
+        for (int i = 0; i < NNUE_HIDDEN; i++) values[i] += column[i];
+    }
+
+    void remove(int piece, int square) {
+        const int16_t* column = nnueColumn(piece, square);
+        for (int i = 0; i < NNUE_HIDDEN; i++) values[i] -= column[i];
+    }
+
+    void move(int piece, int from, int to) {
+        const int16_t* fromColumn = nnueColumn(piece, from);
+        const int16_t* toColumn = nnueColumn(piece, to);
+        for (int i = 0; i < NNUE_HIDDEN; i++) values[i] += toColumn[i] - fromColumn[i];
+    }
+};
+
+// Black's score from the accumulator, as heuristic() gives it
+int nnueEvaluate(const NnueAccumulator &accumulator) {
+    int32_t sum = 0;
+
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ceiling = _mm256_set1_epi16(127);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sums = zero;
+
+    for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+        __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i*>(accumulator.values + i));
+        __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i*>(accumulator.values + i + 16));
+        low = _mm256_min_epi16(_mm256_max_epi16(low, zero), ceiling);
+        high = _mm256_min_epi16(_mm256_max_epi16(high, zero), ceiling);
+
+        // Packing works within 128-bit halves, so the quarters come out as 0 2 1 3 and are put back in order
+        __m256i activations = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        __m256i weights = _mm256_load_si256(reinterpret_cast<const __m256i*>(nnueNetwork.outputWeights + i));
+
+        // Unsigned activations times signed weights, pairwise into 16 bits (at most 2 * 127 * 128) and then 32
+        sums = _mm256_add_epi32(sums, _mm256_madd_epi16(_mm256_maddubs_epi16(activations, weights), ones));
+    }
+
+    __m128i quarter = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    quarter = _mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, _MM_SHUFFLE(1, 0, 3, 2)));
+    quarter = _mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(quarter);
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int activation = accumulator.values[i] < 0? 0 : accumulator.values[i] > 127? 127 : accumulator.values[i];
+        sum += activation * nnueNetwork.outputWeights[i];
+    }
+#endif
+
+    return (sum + nnueNetwork.outputBias) / (1 << NNUE_OUTPUT_SHIFT);
+}
+
+// Reads a network written in the format above; on failure the current one is kept
+bool loadNnue(const std::string &path) {
+    static const char FILE_MAGIC[8] = {'P', 'R', 'N', 'N', 'U', 'E', 0, 0};
+
+    std::ifstream file(path, std::ios::binary);
+    char magic[8];
+    uint32_t version = 0, hidden = 0;
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, FILE_MAGIC, sizeof(magic))
+        || !file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != NNUE_FILE_VERSION
+        || !file.read(reinterpret_cast<char*>(&hidden), sizeof(hidden)) || hidden != NNUE_HIDDEN) {
+        return false;
+    }
+
+    static NnueNetwork network;
+    if (!file.read(reinterpret_cast<char*>(network.featureWeights), sizeof(network.featureWeights))
+        || !file.read(reinterpret_cast<char*>(network.featureBiases), sizeof(network.featureBiases))
+        || !file.read(reinterpret_cast<char*>(network.outputWeights), sizeof(network.outputWeights))
+        || !file.read(reinterpret_cast<char*>(&network.outputBias), sizeof(network.outputBias))
+        || file.peek() != std::ifstream::traits_type::eof()) {
+        return false;
+    }
+
+    nnueNetwork = network;
+    nnueLoaded = true;
+    return true;
+}
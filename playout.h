@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "types.h"
+#include "bitboard.h"
+#include "game.h"
+#include "board.h"
+#include "move.h"
+#include "side.h"
+
+#if defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Random playouts for MCTS, several games at a time. Every lane holds its own copy of the piece bitboards
+// and all lanes move in lockstep, so the set-wise work (empty squares, pawn pushes and captures, knight
+// jumps, slider fills) is done for all of them with one vector instruction per step: 8 lanes with
+// AVX-512, 4 with AVX2 or plain loops. Picking and playing the random move is then scalar per lane.
+// Moves are drawn uniformly from exactly the moves getValidMoves() would generate, and a lane drops out
+// as soon as its game is over.
+
+#define PLAYOUT_SIMD true
+
+#if PLAYOUT_SIMD && defined(__AVX512F__)
+#define PLAYOUT_LANES 8
+#else
+#define PLAYOUT_LANES 4
+#endif
+
+// One bitboard per lane
+struct alignas(64) Lanes {
+#if PLAYOUT_SIMD && defined(__AVX512F__)
+    __m512i v;
+
+    static Lanes load(const u64 *bits) { return {_mm512_load_si512(bits)}; }
+    static Lanes broadcast(u64 bits) { return {_mm512_set1_epi64(static_cast<long long>(bits))}; }
+    void store(u64 *bits) const { _mm512_store_si512(bits, v); }
+
+    Lanes operator&(Lanes other) const { return {_mm512_and_si512(v, other.v)}; }
+    Lanes operator|(Lanes other) const { return {_mm512_or_si512(v, other.v)}; }
+    // The zero-masked forms compile to the same instructions, without GCC 12 warning about the
+    // undefined pass-through operand of the unmasked ones
+    Lanes andNot(Lanes other) const { return {_mm512_maskz_andnot_epi64(0xFF, other.v, v)}; }
+    template<unsigned n> Lanes shl() const { return {_mm512_maskz_slli_epi64(0xFF, v, n)}; }
+    template<unsigned n> Lanes shr() const { return {_mm512_maskz_srli_epi64(0xFF, v, n)}; }
+#elif PLAYOUT_SIMD && defined(__AVX2__)
+    __m256i v;
+
+    static Lanes load(const u64 *bits) { return {_mm256_load_si256(reinterpret_cast<const __m256i*>(bits))}; }
+    static Lanes broadcast(u64 bits) { return {_mm256_set1_epi64x(static_cast<long long>(bits))}; }
+    void store(u64 *bits) const { _mm256_store_si256(reinterpret_cast<__m256i*>(bits), v); }
+
+    Lanes operator&(Lanes other) const { return {_mm256_and_si256(v, other.v)}; }
+    Lanes operator|(Lanes other) const { return {_mm256_or_si256(v, other.v)}; }
+    Lanes andNot(Lanes other) const { return {_mm256_andnot_si256(other.v, v)}; }
+    template<unsigned n> Lanes shl() const { return {_mm256_slli_epi64(v, n)}; }
+    template<unsigned n> Lanes shr() const { return {_mm256_srli_epi64(v, n)}; }
+#else
+    u64 v[PLAYOUT_LANES];
+
+    static Lanes load(const u64 *bits) { Lanes lanes; memcpy(lanes.v, bits, sizeof(lanes.v)); return lanes; }
+    static Lanes broadcast(u64 bits) { Lanes lanes; for (auto &lane : lanes.v) lane = bits; return lanes; }
+    void store(u64 *bits) const { memcpy(bits, v, sizeof(v)); }
+
+    template<typename Op>
+    Lanes apply(Op op) const { Lanes lanes; for (int i = 0; i < PLAYOUT_LANES; i++) lanes.v[i] = op(i); return lanes; }
+
+    Lanes operator&(Lanes other) const { return apply([&](int i) { return v[i] & other.v[i]; }); }
+    Lanes operator|(Lanes other) const { return apply([&](int i) { return v[i] | other.v[i]; }); }
+    Lanes andNot(Lanes other) const { return apply([&](int i) { return v[i] & ~other.v[i]; }); }
+    template<unsigned n> Lanes shl() const { return apply([&](int i) { return v[i] << n; }); }
+    template<unsigned n> Lanes shr() const { return apply([&](int i) { return v[i] >> n; }); }
+#endif
+};
+
+struct PlayoutResult {
+    u32 blackWins = 0;
+    u32 whiteWins = 0;
+};
+
+class PlayoutKernel {
+public:
+    static const int LANES = PLAYOUT_LANES;
+
+    explicit PlayoutKernel(u64 seed = 1) : rngState(seed? seed : 1) {
+        for (auto &moves : played) {
+            moves.reserve(256);
+        }
+    }
+
+    void seed(u64 seed) {
+        rngState = seed? seed : 1;
+    }
+
+    // Plays LANES random games from `board` with `range` to move and counts who won them
+    PlayoutResult run(const Board &board, PieceRange range) {
+        load(board, range);
+        while (activeLanes) {
+            step();
+        }
+
+        PlayoutResult result;
+        for (int lane = 0; lane < LANES; lane++) {
+            if (outcome[lane] == GameState::BlackWins) result.blackWins++;
+            else result.whiteWins++;
+        }
+        return result;
+    }
+
+    void load(const Board &board, PieceRange range) {
+        for (int type = 1; type <= 10; type++) {
+            for (int lane = 0; lane < LANES; lane++) {
+                pieces[type][lane] = board.pieces[type];
+            }
+        }
+
+        toMove = range;
+        activeLanes = 0;
+        for (auto &moves : played) {
+            moves.clear();
+        }
+        GameState state = board.getGameState();
+        for (int lane = 0; lane < LANES; lane++) {
+            outcome[lane] = state;
+            if (state == GameState::IsPlaying) activeLanes |= 1u << lane;
+        }
+    }
+
+    // Plays one random move in every lane whose game is still going
+    void step() {
+        if (toMove == PieceRange::White) {
+            step<PieceRange::White>();
+        } else {
+            step<PieceRange::Black>();
+        }
+        toMove = opponentOf(toMove);
+    }
+
+    // A lane's position as a Board, for checking the kernel against the move generator
+    Board laneBoard(int lane) const {
+        Board board;
+        for (int type = 1; type <= 10; type++) {
+            board.pieces[type] = pieces[type][lane];
+        }
+        board.updatePieceAggregates();
+        return board;
+    }
+
+    PieceRange sideToMove() const {
+        return toMove;
+    }
+
+    // Whether to keep the moves each lane plays, which costs a few percent of throughput
+    bool recordMoves = false;
+
+    // The moves a lane's game went through since load() when recordMoves is set
+    const std::vector<Move>& movesPlayed(int lane) const {
+        return played[lane];
+    }
+
+    GameState laneOutcome(int lane) const {
+        return outcome[lane];
+    }
+
+private:
+    // Target sets per lane: 3 pawn, 8 knight, 4 rook and 4 bishop, each reached from exactly one piece
+    static const int SET_COUNT = 19;
+
+    alignas(64) u64 pieces[11][LANES];
+    alignas(64) u64 sets[SET_COUNT][LANES];
+    alignas(64) u64 empties[LANES];
+    GameState outcome[LANES];
+    std::vector<Move> played[LANES];
+    unsigned activeLanes = 0;
+    PieceRange toMove = PieceRange::White;
+    u64 rngState;
+
+    // xorshift64*; plenty for picking playout moves
+    u64 nextRandom() {
+        rngState ^= rngState >> 12u;
+        rngState ^= rngState << 25u;
+        rngState ^= rngState >> 27u;
+        return rngState * C64(0x2545F4914F6CDD1D);
+    }
+
+    template<PieceRange range, unsigned n>
+    static Lanes advance(Lanes bits) {
+        if constexpr (range == PieceRange::White) return bits.template shl<n>();
+        else return bits.template shr<n>();
+    }
+
+    template<ScanDirection direction, unsigned steps>
+    static Lanes shiftTowards(Lanes bits) {
+        if constexpr (direction < South) return bits.template shl<directionStep<direction>() * steps>();
+        else return bits.template shr<directionStep<direction>() * steps>();
+    }
+
+    // slidingAttacks() for every lane at once; `empty` is already limited to the seven real columns
+    template<ScanDirection direction>
+    static Lanes slidingAttacks(Lanes sliders, Lanes empty) {
+        sliders = sliders | (empty & shiftTowards<direction, 1>(sliders));
+        empty = empty & shiftTowards<direction, 1>(empty);
+        sliders = sliders | (empty & shiftTowards<direction, 2>(sliders));
+        empty = empty & shiftTowards<direction, 2>(empty);
+        sliders = sliders | (empty & shiftTowards<direction, 4>(sliders));
+        return shiftTowards<direction, 1>(sliders) & Lanes::broadcast(rightColMask);
+    }
+
+    static constexpr ScanDirection opposite(ScanDirection direction) {
+        return direction == North? South : direction == South? North : direction == East? West : direction == West? East
+             : direction == NorthEast? SouthWest : direction == SouthWest? NorthEast
+             : direction == NorthWest? SouthEast : NorthWest;
+    }
+
+    template<PieceRange range>
+    void computeTargetSets() {
+        using Side = SideTraits<range>;
+        using Opponent = SideTraits<Side::opponent>;
+
+        Lanes own = Lanes::load(pieces[Side::pawn]) | Lanes::load(pieces[Side::knight]) | Lanes::load(pieces[Side::rook])
+                  | Lanes::load(pieces[Side::bishop]) | Lanes::load(pieces[Side::car]);
+        Lanes captures = Lanes::load(pieces[Opponent::pawn]) | Lanes::load(pieces[Opponent::knight])
+                       | Lanes::load(pieces[Opponent::rook]) | Lanes::load(pieces[Opponent::bishop]);
+        Lanes empty = Lanes::broadcast(rightColMask).andNot(own | captures | Lanes::load(pieces[Opponent::car]));
+        Lanes quiet = empty | captures;
+        empty.store(empties);
+
+        Lanes pawns = Lanes::load(pieces[Side::pawn]);
+        (advance<range, 9>(pawns) & Lanes::broadcast(Side::pawnCapture9Mask) & captures).store(sets[0]);
+        (advance<range, 7>(pawns) & Lanes::broadcast(Side::pawnCapture7Mask) & captures).store(sets[1]);
+        (advance<range, 8>(pawns) & empty).store(sets[2]);
+
+        // Knights jump anywhere forward, but only capture backward
+        Lanes knights = Lanes::load(pieces[Side::knight]);
+        Lanes up = range == PieceRange::White? quiet : captures;
+        Lanes down = range == PieceRange::White? captures : quiet;
+        ((knights & Lanes::broadcast(leftTwoColMask)).template shl<6>() & up).store(sets[3]);
+        ((knights & Lanes::broadcast(leftColMask)).template shl<15>() & up).store(sets[4]);
+        ((knights & Lanes::broadcast(rightColMask)).template shl<17>() & up).store(sets[5]);
+        ((knights & Lanes::broadcast(rightTwoColMask)).template shl<10>() & up).store(sets[6]);
+        ((knights & Lanes::broadcast(rightTwoColMask)).template shr<6>() & down).store(sets[7]);
+        ((knights & Lanes::broadcast(rightColMask)).template shr<15>() & down).store(sets[8]);
+        ((knights & Lanes::broadcast(leftColMask)).template shr<17>() & down).store(sets[9]);
+        ((knights & Lanes::broadcast(leftTwoColMask)).template shr<10>() & down).store(sets[10]);
+
+        Lanes rooks = Lanes::load(pieces[Side::rook]);
+        (slidingAttacks<Side::rookForward>(rooks, empty) & quiet).store(sets[11]);
+        (slidingAttacks<Side::rookCaptures[0]>(rooks, empty) & captures).store(sets[12]);
+        (slidingAttacks<Side::rookCaptures[1]>(rooks, empty) & captures).store(sets[13]);
+        (slidingAttacks<Side::rookCaptures[2]>(rooks, empty) & captures).store(sets[14]);
+
+        Lanes bishops = Lanes::load(pieces[Side::bishop]);
+        (slidingAttacks<Side::bishopForward[0]>(bishops, empty) & quiet).store(sets[15]);
+        (slidingAttacks<Side::bishopForward[1]>(bishops, empty) & quiet).store(sets[16]);
+        (slidingAttacks<Side::bishopCaptures[0]>(bishops, empty) & captures).store(sets[17]);
+        (slidingAttacks<Side::bishopCaptures[1]>(bishops, empty) & captures).store(sets[18]);
+    }
+
+    // The slider that reaches `target` going in `direction`: the first piece met walking back from it
+    template<ScanDirection direction>
+    static u64 sliderOrigin(u64 target, u64 empty, u64 sliders) {
+        return ::slidingAttacks<opposite(direction)>(target, empty) & sliders;
+    }
+
+    template<PieceRange range>
+    u64 originOf(int set, u64 target, int lane) const {
+        using Side = SideTraits<range>;
+        const u64 empty = empties[lane];
+        const u64 rooks = pieces[Side::rook][lane];
+        const u64 bishops = pieces[Side::bishop][lane];
+
+        switch (set) {
+            case 0: return range == PieceRange::White? target >> 9u : target << 9u;
+            case 1: return range == PieceRange::White? target >> 7u : target << 7u;
+            case 2: return range == PieceRange::White? target >> 8u : target << 8u;
+            case 3: return target >> 6u;
+            case 4: return target >> 15u;
+            case 5: return target >> 17u;
+            case 6: return target >> 10u;
+            case 7: return target << 6u;
+            case 8: return target << 15u;
+            case 9: return target << 17u;
+            case 10: return target << 10u;
+            case 11: return sliderOrigin<Side::rookForward>(target, empty, rooks);
+            case 12: return sliderOrigin<Side::rookCaptures[0]>(target, empty, rooks);
+            case 13: return sliderOrigin<Side::rookCaptures[1]>(target, empty, rooks);
+            case 14: return sliderOrigin<Side::rookCaptures[2]>(target, empty, rooks);
+            case 15: return sliderOrigin<Side::bishopForward[0]>(target, empty, bishops);
+            case 16: return sliderOrigin<Side::bishopForward[1]>(target, empty, bishops);
+            case 17: return sliderOrigin<Side::bishopCaptures[0]>(target, empty, bishops);
+            default: return sliderOrigin<Side::bishopCaptures[1]>(target, empty, bishops);
+        }
+    }
+
+    template<PieceRange range>
+    static PieceType pieceOf(int set) {
+        using Side = SideTraits<range>;
+        return set < 3? Side::pawn : set < 11? Side::knight : set < 15? Side::rook : Side::bishop;
+    }
+
+    static u64 selectBit(u64 bits, u64 index) {
+#if defined(__BMI2__)
+        return _pdep_u64(C64(1) << index, bits);
+#else
+        while (index--) bits &= bits - 1;
+        return bits & (~bits + 1);
+#endif
+    }
+
+    // Takes whatever stands on `to` off the board, then moves the piece
+    void movePiece(int lane, PieceType piece, u64 from, u64 to) {
+        if (recordMoves) played[lane].push_back(Move{piece, static_cast<u8>(__builtin_ctzll(from)), static_cast<u8>(__builtin_ctzll(to))});
+        for (int type = 1; type <= 10; type++) {
+            pieces[type][lane] &= ~to;
+        }
+        pieces[piece][lane] |= to;
+        pieces[piece][lane] &= ~from;
+    }
+
+    template<PieceRange range>
+    void step() {
+        using Side = SideTraits<range>;
+
+        computeTargetSets<range>();
+
+        for (int lane = 0; lane < LANES; lane++) {
+            if (!(activeLanes & (1u << lane))) continue;
+
+            u32 counts[SET_COUNT];
+            u32 total = 0;
+            for (int set = 0; set < SET_COUNT; set++) {
+                counts[set] = static_cast<u32>(__builtin_popcountll(sets[set][lane]));
+                total += counts[set];
+            }
+
+            // The car moves onto an empty square, or over anything once nothing else can move
+            const u64 car = pieces[Side::car][lane];
+            u64 carTarget = 0;
+            for (int i = 0; i < 6; i++) {
+                if (car == pieceLookupTable[Side::carPath[i]]) carTarget = pieceLookupTable[Side::carPath[i + 1]];
+            }
+            bool carMoves = carTarget && ((carTarget & empties[lane]) || total == 0);
+
+            u64 choice = ((nextRandom() >> 32u) * (total + carMoves)) >> 32u;
+            if (choice == total) {
+                movePiece(lane, Side::car, car, carTarget);
+                if (carTarget == pieceLookupTable[Side::carPath[6]]) {
+                    outcome[lane] = range == PieceRange::White? GameState::WhiteWins : GameState::BlackWins;
+                    activeLanes &= ~(1u << lane);
+                }
+                continue;
+            }
+
+            int set = 0;
+            while (choice >= counts[set]) {
+                choice -= counts[set];
+                set++;
+            }
+            u64 target = selectBit(sets[set][lane], choice);
+            movePiece(lane, pieceOf<range>(set), originOf<range>(set, target, lane), target);
+        }
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "types.h"
+#include "bitboard.h"
+#include "game.h"
+#include "board.h"
+#include "side.h"
+
+// Static resolution of the car race. A car's road is settled when every square left on it is empty and
+// no opposing piece could possibly stand on one of them by the time the car gets there. In that case the
+// side whose car needs fewer moves (the side to move wins ties) has won, without any search.
+//
+// Reach is over-estimated on purpose, so that a verdict is never wrong: pieces move as if the board were
+// empty, rooks and bishops slide in all four of their directions and knights jump both ways.
+
+enum class RaceOutcome {
+    Unknown,
+    Won,    // for the side to move
+    Lost,
+};
+
+struct RaceResult {
+    RaceOutcome outcome = RaceOutcome::Unknown;
+    int tempo = 0;      // Moves the winning car still needs
+};
+
+inline u64 knightAttacks(u64 knights) {
+    return (((knights & leftTwoColMask)  << 6u)  | ((knights & leftColMask)     << 15u)
+          | ((knights & rightColMask)    << 17u) | ((knights & rightTwoColMask) << 10u)
+          | ((knights & rightTwoColMask) >> 6u)  | ((knights & rightColMask)    >> 15u)
+          | ((knights & leftColMask)     >> 17u) | ((knights & leftTwoColMask)  >> 10u)) & rightColMask;
+}
+
+// Index of the car on its path, so the number of car moves left is 6 minus this, or -1 once it's gone
+template<PieceRange range>
+inline int carPathIndex(const Board &board) {
+    using Side = SideTraits<range>;
+
+    const u64 car = board.pieces[Side::car];
+    for (int i = 0; i < 6; i++) {
+        if (car == pieceLookupTable[Side::carPath[i]]) return i;
+    }
+    return -1;
+}
+
+// Squares that `range`'s pieces (other than the car) could occupy after one more move each
+template<PieceRange range>
+struct RaceReach {
+    using Side = SideTraits<range>;
+
+    u64 pawns, knights, rooks, bishops;
+
+    explicit RaceReach(const Board &board)
+        : pawns(board.pieces[Side::pawn]), knights(board.pieces[Side::knight]),
+          rooks(board.pieces[Side::rook]), bishops(board.pieces[Side::bishop]) {}
+
+    u64 squares() const {
+        return pawns | knights | rooks | bishops;
+    }
+
+    void step() {
+        pawns |= (Side::advance(pawns, 8u) | (Side::advance(pawns, 9u) & Side::pawnCapture9Mask)
+                  | (Side::advance(pawns, 7u) & Side::pawnCapture7Mask)) & rightColMask;
+        knights |= knightAttacks(knights);
+
+        u64 attacks[4];
+        slidingAttacks4<North, South, East, West>(rooks, U64_MAX, attacks);
+        rooks |= attacks[0] | attacks[1] | attacks[2] | attacks[3];
+        slidingAttacks4<NorthEast, NorthWest, SouthEast, SouthWest>(bishops, U64_MAX, attacks);
+        bishops |= attacks[0] | attacks[1] | attacks[2] | attacks[3];
+    }
+};
+
+// True if `racer`'s car, standing at `pathIdx`, can't be stopped when `blocker` gets `headStart` moves before
+// the car's first move and one more before each following one
+template<PieceRange racer>
+inline bool raceIsClear(const Board &board, int pathIdx, int headStart) {
+    using Side = SideTraits<racer>;
+
+    u64 road = 0;
+    for (int i = pathIdx + 1; i <= 6; i++) {
+        road |= pieceLookupTable[Side::carPath[i]];
+    }
+    if (road & board.allPieces) return false;
+
+    RaceReach<Side::opponent> reach(board);
+    for (int i = 0; i < headStart; i++) {
+        reach.step();
+    }
+
+    for (int i = pathIdx + 1; i <= 6; i++) {
+        if (reach.squares() & pieceLookupTable[Side::carPath[i]]) return false;
+        if (i < 6) reach.step();
+    }
+
+    return true;
+}
+
+template<PieceRange range>
+RaceResult resolveRace(const Board &board) {
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+    int ownIdx = carPathIndex<range>(board);
+    int enemyIdx = carPathIndex<opponent>(board);
+    if (ownIdx < 0 || enemyIdx < 0) return {};
+
+    int ownTempo = 6 - ownIdx;
+    int enemyTempo = 6 - enemyIdx;
+
+    if (ownTempo <= enemyTempo) {
+        if (raceIsClear<range>(board, ownIdx, 0)) return RaceResult{RaceOutcome::Won, ownTempo};
+    } else {
+        if (raceIsClear<opponent>(board, enemyIdx, 1)) return RaceResult{RaceOutcome::Lost, enemyTempo};
+    }
+
+    return {};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+#include "types.h"
+#include "bitboard.h"
+
+// Random numbers for the strategies. rand() takes a lock in glibc and shares one sequence between all
+// threads, so each thread gets its own xoshiro256** generator instead, all derived from a seed chosen
+// once per game. A game played again with the same seed makes the same random choices, provided its
+// searches are given the same amount of work.
+
+// xoshiro256**, seeded through SplitMix64 so that any seed, even 0, gives a well-mixed state
+class Rng {
+public:
+    using result_type = u64;
+
+    explicit Rng(u64 seed = 1) {
+        reseed(seed);
+    }
+
+    void reseed(u64 seed) {
+        for (auto &word : state) word = splitMix64(seed);
+    }
+
+    u64 next() {
+        const u64 result = rotate(state[1] * 5, 7) * 9;
+        const u64 t = state[1] << 17u;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate(state[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound) for bound > 0, by Lemire's multiply-and-reject: the high half of a 32x32 bit
+    // product picks the value and the few products that would favour some values are drawn again. The
+    // division only happens in the rare case that a product comes close to being rejected.
+    uint32_t below(uint32_t bound) {
+        uint64_t product = (next() >> 32u) * static_cast<uint64_t>(bound);
+        auto low = static_cast<uint32_t>(product);
+        if (unlikely(low < bound)) {
+            const uint32_t threshold = static_cast<uint32_t>(-bound) % bound;
+            while (low < threshold) {
+                product = (next() >> 32u) * static_cast<uint64_t>(bound);
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32u);
+    }
+
+    // Fisher-Yates with below(), so every order is equally likely
+    template<typename Iterator>
+    void shuffle(Iterator first, Iterator last) {
+        for (auto n = last - first; n > 1; n--) {
+            std::iter_swap(first + (n - 1), first + below(static_cast<uint32_t>(n)));
+        }
+    }
+
+    // For the standard library's distributions and algorithms
+    u64 operator()() { return next(); }
+    static constexpr u64 min() { return 0; }
+    static constexpr u64 max() { return U64_MAX; }
+
+private:
+    u64 state[4];
+
+    static u64 rotate(u64 x, unsigned k) {
+        return (x << k) | (x >> (64u - k));
+    }
+};
+
+static std::atomic<u64> gameSeed{1};
+static std::atomic<u64> rngThreadCount{0};
+
+// The calling thread's generator. A thread's first call seeds it from the game seed and the order in
+// which threads first asked, so each one draws a different sequence.
+inline Rng& threadRng() {
+    thread_local Rng rng(gameSeed.load() ^ (rngThreadCount.fetch_add(1) * C64(0xD1B54A32D192ED03)));
+    return rng;
+}
+
+// Starts a new game's random numbers: the calling thread and threads that draw for the first time from
+// now on derive theirs from `seed`
+inline void seedRandom(u64 seed) {
+    gameSeed.store(seed);
+    threadRng().reseed(seed);
+}
+
+inline u64 randomSeed() {
+    return gameSeed.load();
+}
+
+// A seed that differs from run to run, for games that weren't given one
+inline u64 freshSeed() {
+    u64 seed = std::random_device{}();
+    seed = seed << 32u ^ static_cast<u64>(std::chrono::steady_clock::now().time_since_epoch().count());
+    return splitMix64(seed);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../board.h"
+#include "../move.h"
+#include "protocol.h"
+
+// Blocking connection to phantomracer_server, so the CLI game can leave the searching to the server
+class RemoteEngine {
+public:
+    RemoteEngine() = default;
+    RemoteEngine(const RemoteEngine&) = delete;
+    RemoteEngine& operator=(const RemoteEngine&) = delete;
+
+    ~RemoteEngine() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool connectTo(const std::string &address) {
+        sockaddr_storage storage;
+        socklen_t length = makeSocketAddress(address, storage);
+        if (length == 0) return false;
+
+        fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool setPosition(const Board &board, PieceRange range) {
+        std::string reply;
+        return request("position " + boardToString(board, range), reply) && reply == "ok";
+    }
+
+    bool playMove(const Move &move) {
+        std::string reply;
+        return request("move " + moveToText(move), reply) && reply.compare(0, 2, "ok") == 0;
+    }
+
+    // Asks the server for black's move and plays it there; waits and retries while the server is busy
+    bool computeMove(const MoveList &moves, Move &move) {
+        std::string reply;
+        while (request("go", reply)) {
+            if (reply == "busy") {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            return reply.compare(0, 9, "bestmove ") == 0 && parseMoveText(reply.substr(9, 4), moves, move);
+        }
+        return false;
+    }
+
+private:
+    int fd = -1;
+    std::string buffer;
+
+    bool request(const std::string &line, std::string &reply) {
+        std::string message = line + '\n';
+        size_t sent = 0;
+        while (sent < message.size()) {
+            ssize_t count = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+            if (count <= 0) return false;
+            sent += static_cast<size_t>(count);
+        }
+
+        size_t lineEnd;
+        while ((lineEnd = buffer.find('\n')) == std::string::npos) {
+            char chunk[1024];
+            ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+            if (count <= 0) return false;
+            buffer.append(chunk, static_cast<size_t>(count));
+        }
+
+        reply = buffer.substr(0, lineEnd);
+        buffer.erase(0, lineEnd + 1);
+        return true;
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "../board.h"
+#include "../move.h"
+
+// Line-based text protocol spoken between phantomracer_server and its clients. Each connection is one
+// game session; the client sends one command per line and gets one reply line per command:
+//
+//   position <board>     set the session's board, e.g. the output of boardToString()   -> ok
+//   move <A2A3>          play a move for the side to move                               -> ok [gameover <winner>]
+//   go [ms]              queue a search for black, the computer, within a time budget   -> bestmove <move> [gameover <winner>]
+//   moves                legal moves for the side to move                               -> moves <move> ...
+//   board                                                                               -> board <board>
+//   stats                worker pool and latency figures                                -> stats <key=value ...>
+//   quit                 close the session
+//
+// Any command can instead be answered with `error <reason>`, and `go` with `busy` when the job queue is full.
+
+#define DEFAULT_SERVER_SOCKET "/tmp/phantomracer.sock"
+
+// Addresses are either a Unix socket path or host:port for TCP
+inline bool isTcpAddress(const std::string &address) {
+    return address.find(':') != std::string::npos && address.find('/') == std::string::npos;
+}
+
+// Fills in `storage` for `address`, returning the length to pass to bind() or connect(), or 0 if invalid
+inline socklen_t makeSocketAddress(const std::string &address, sockaddr_storage &storage) {
+    memset(&storage, 0, sizeof(storage));
+
+    if (isTcpAddress(address)) {
+        auto colon = address.rfind(':');
+        auto &inet = reinterpret_cast<sockaddr_in&>(storage);
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons(static_cast<uint16_t>(atoi(address.c_str() + colon + 1)));
+        std::string host = colon == 0? "127.0.0.1" : address.substr(0, colon);
+        if (inet_pton(AF_INET, host.c_str(), &inet.sin_addr) != 1) return 0;
+        return sizeof(sockaddr_in);
+    }
+
+    auto &local = reinterpret_cast<sockaddr_un&>(storage);
+    if (address.empty() || address.size() >= sizeof(local.sun_path)) return 0;
+    local.sun_family = AF_UNIX;
+    strcpy(local.sun_path, address.c_str());
+    return sizeof(sockaddr_un);
+}
+
+// Looks up the legal move written as e.g. "A2A3"
+inline bool parseMoveText(const std::string &text, const MoveList &moves, Move &move) {
+    if (text.size() != 4) return false;
+
+    char buffer[5] = {0};
+    text.copy(buffer, 4);
+    Move parsed{PieceType::EmptyPiece, 0, 0};
+    buffer >> parsed;
+
+    for (auto possibleMove : moves.moves) {
+        if (parsed == possibleMove) {
+            move = possibleMove;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string moveToText(const Move &move) {
+    std::string text;
+    text += static_cast<char>('A' + move.fromCell % 8);
+    text += static_cast<char>('1' + move.fromCell / 8);
+    text += static_cast<char>('A' + move.toCell % 8);
+    text += static_cast<char>('1' + move.toCell / 8);
+    return text;
+}
+
+inline const char* winnerName(GameState state) {
+    return state == GameState::WhiteWins? "white" : "black";
+}
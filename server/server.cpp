@@ -0,0 +1,376 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../bitboard.h"
+#include "../board.h"
+#include "../move.h"
+#include "protocol.h"
+#include "workers.h"
+
+// Hosts many games in one process. A single thread multiplexes every connection with epoll and hands
+// searches to a shared worker pool; see protocol.h for the commands.
+//
+// Usage: phantomracer_server [--listen ADDRESS] [--workers N] [--max-queue N] [--budget-ms N] [--tt-file PATH]
+
+struct Session {
+    u64 id;
+    Board board;
+    PieceRange toMove = PieceRange::White;
+    bool searching = false;
+    std::string input;
+    std::string output;
+};
+
+class GameServer {
+public:
+    GameServer(int listenFd, WorkerPool &pool, int budgetMs) : listenFd(listenFd), pool(pool), budgetMs(budgetMs) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        watch(listenFd, EPOLLIN);
+        watch(pool.eventFd(), EPOLLIN);
+    }
+
+    void run() {
+        epoll_event events[256];
+
+        while (true) {
+            int count = epoll_wait(epollFd, events, 256, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait: " << strerror(errno) << std::endl;
+                return;
+            }
+
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptAll();
+                } else if (fd == pool.eventFd()) {
+                    deliverResults();
+                } else {
+                    auto session = sessions.find(fd);
+                    if (session == sessions.end()) continue;
+
+                    bool open = true;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) open = readInput(fd, session->second);
+                    if (open) open = flushOutput(fd, session->second);
+                    if (!open) closeSession(fd);
+                }
+            }
+        }
+    }
+
+private:
+    int listenFd;
+    int epollFd;
+    int spareFd;        // Held in reserve so that a connection can still be refused when out of descriptors
+    bool listenerPaused = false;
+    WorkerPool &pool;
+    int budgetMs;
+
+    u64 nextSessionId = 1;
+    std::unordered_map<int, Session> sessions;
+    std::unordered_map<u64, int> sessionFds;
+
+    LatencyStats latency;
+    u64 jobsRejected = 0;
+
+    void watch(int fd, u32 events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if ((errno == EMFILE || errno == ENFILE) && spareFd >= 0) {
+                    // The connection would stay queued and keep the listener readable, so epoll would spin
+                    // on it: free the spare descriptor to accept and drop it, then take the spare back
+                    close(spareFd);
+                    fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd >= 0) close(fd);
+                    spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    if (fd >= 0) continue;
+                }
+                if (errno == EMFILE || errno == ENFILE) {
+                    // Without a spare, stop listening until a session closes and gives a descriptor back
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+                    listenerPaused = true;
+                }
+                return;
+            }
+
+            Session session;
+            session.id = nextSessionId++;
+            sessionFds[session.id] = fd;
+            sessions.emplace(fd, std::move(session));
+            watch(fd, EPOLLIN);
+        }
+    }
+
+    void closeSession(int fd) {
+        auto session = sessions.find(fd);
+        if (session != sessions.end()) {
+            sessionFds.erase(session->second.id);
+            sessions.erase(session);
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+
+        if (listenerPaused) {
+            listenerPaused = false;
+            if (spareFd < 0) spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            watch(listenFd, EPOLLIN);
+        }
+    }
+
+    // Returns false once the client has gone
+    bool readInput(int fd, Session &session) {
+        char buffer[4096];
+        while (true) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received == 0) return false;
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            session.input.append(buffer, static_cast<size_t>(received));
+
+            size_t lineEnd;
+            while ((lineEnd = session.input.find('\n')) != std::string::npos) {
+                std::string line = session.input.substr(0, lineEnd);
+                session.input.erase(0, lineEnd + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!handleCommand(session, line)) return false;
+            }
+
+            // A client that never ends its line isn't speaking the protocol; checked per read, so one
+            // that keeps sending can't grow the buffer or hold up the loop for long
+            if (session.input.size() >= sizeof(buffer)) return false;
+        }
+    }
+
+    // Writes what the socket will take and asks epoll for writability while anything is left over
+    bool flushOutput(int fd, Session &session) {
+        while (!session.output.empty()) {
+            ssize_t sent = send(fd, session.output.data(), session.output.size(), MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            session.output.erase(0, static_cast<size_t>(sent));
+        }
+
+        epoll_event event{};
+        event.events = session.output.empty()? EPOLLIN : EPOLLIN | EPOLLOUT;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        return true;
+    }
+
+    static void appendGameOver(Session &session) {
+        GameState state = session.board.getGameState();
+        if (state != GameState::IsPlaying) {
+            session.output += " gameover ";
+            session.output += winnerName(state);
+        }
+    }
+
+    // Returns false when the session should be closed
+    bool handleCommand(Session &session, const std::string &line) {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+
+        if (command == "quit") return false;
+
+        if (command == "stats") {
+            session.output += statsLine() + '\n';
+            return true;
+        }
+
+        if (command == "moves") {
+            session.output += "moves";
+            for (auto move : session.board.getValidMoves(session.toMove).moves) {
+                session.output += ' ' + moveToText(move);
+            }
+            session.output += '\n';
+            return true;
+        }
+
+        if (command == "board") {
+            session.output += "board " + boardToString(session.board, session.toMove) + '\n';
+            return true;
+        }
+
+        if (session.searching) {
+            session.output += "error searching\n";
+            return true;
+        }
+
+        if (command == "position") {
+            std::string text;
+            std::getline(stream >> std::ws, text);
+            if (parseBoard(text, session.board, session.toMove)) {
+                session.output += "ok\n";
+            } else {
+                session.output += "error invalid position\n";
+            }
+        } else if (command == "move") {
+            std::string text;
+            stream >> text;
+            Move move{PieceType::EmptyPiece, 0, 0};
+            if (session.board.getGameState() != GameState::IsPlaying) {
+                session.output += "error game over\n";
+            } else if (!parseMoveText(text, session.board.getValidMoves(session.toMove), move)) {
+                session.output += "error illegal move\n";
+            } else {
+                session.board.performMove(session.toMove, move);
+                session.toMove = opponentOf(session.toMove);
+                session.output += "ok";
+                appendGameOver(session);
+                session.output += '\n';
+            }
+        } else if (command == "go") {
+            int requestedMs;
+            if (!(stream >> requestedMs)) requestedMs = budgetMs;
+            if (session.toMove != PieceRange::Black) {
+                session.output += "error computer plays black\n";
+            } else if (session.board.getGameState() != GameState::IsPlaying) {
+                session.output += "error game over\n";
+            } else if (!pool.submit(SearchJob{session.id, session.board, std::max(1, std::min(requestedMs, budgetMs)),
+                                              std::chrono::steady_clock::now()})) {
+                jobsRejected++;
+                session.output += "busy\n";
+            } else {
+                session.searching = true;
+            }
+        } else {
+            session.output += "error unknown command\n";
+        }
+
+        return true;
+    }
+
+    void deliverResults() {
+        for (const auto &result : pool.takeResults()) {
+            latency.add(result.latencyMs);
+
+            auto fd = sessionFds.find(result.sessionId);
+            if (fd == sessionFds.end()) continue;
+
+            Session &session = sessions[fd->second];
+            session.searching = false;
+            session.board.performMove<PieceRange::Black>(result.move);
+            session.toMove = PieceRange::White;
+            session.output += "bestmove " + moveToText(result.move);
+            appendGameOver(session);
+            session.output += '\n';
+
+            if (!flushOutput(fd->second, session)) closeSession(fd->second);
+        }
+    }
+
+    std::string statsLine() {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1)
+             << "stats sessions=" << sessions.size()
+             << " workers=" << pool.workerCount()
+             << " busy=" << pool.busyWorkers()
+             << " queued=" << pool.queueLength()
+             << " completed=" << latency.count()
+             << " rejected=" << jobsRejected
+             << " p50_ms=" << latency.percentile(0.5)
+             << " p90_ms=" << latency.percentile(0.9)
+             << " p99_ms=" << latency.percentile(0.99)
+             << " max_ms=" << latency.percentile(1.0);
+        return line.str();
+    }
+};
+
+static int openListener(const std::string &address) {
+    sockaddr_storage storage;
+    socklen_t length = makeSocketAddress(address, storage);
+    if (length == 0) {
+        std::cerr << "Invalid address: " << address << std::endl;
+        return -1;
+    }
+
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (storage.ss_family == AF_UNIX) {
+        unlink(address.c_str());
+    } else {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 || listen(fd, SOMAXCONN) < 0) {
+        std::cerr << "Could not listen on " << address << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    std::string address = DEFAULT_SERVER_SOCKET;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxQueue = 1024;
+    int budgetMs = 1000;
+    const char* tableFile = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--listen") && i + 1 < argc) {
+            address = argv[++i];
+        } else if (!strcmp(argv[i], "--workers") && i + 1 < argc) {
+            workers = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else if (!strcmp(argv[i], "--max-queue") && i + 1 < argc) {
+            maxQueue = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        } else if (!strcmp(argv[i], "--budget-ms") && i + 1 < argc) {
+            budgetMs = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--tt-file") && i + 1 < argc) {
+            tableFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--listen ADDRESS] [--workers N] [--max-queue N] [--budget-ms N] [--tt-file PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    initAll();
+    signal(SIGPIPE, SIG_IGN);
+
+    if (tableFile && !openTableFile(tableFile, TT_FILE_BITS)) {
+        std::cerr << "Could not open " << tableFile << std::endl;
+        return 1;
+    }
+
+    int listenFd = openListener(address);
+    if (listenFd < 0) return 1;
+
+    WorkerPool pool(workers, maxQueue);
+    std::cout << "Listening on " << address << " with " << workers << " workers" << std::endl;
+
+    GameServer server(listenFd, pool, budgetMs);
+    server.run();
+    return 1;
+}
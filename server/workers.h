@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "../board.h"
+#include "../dfpn.h"
+#include "../move.h"
+#include "../strategy/minimax.h"
+
+// Fixed pool of search threads shared by every session. The epoll loop submits jobs and is woken through
+// an eventfd when results are ready, so sockets are only ever touched by the loop's thread.
+
+#define SERVER_DFPN_NODES 20000
+
+// How often the shared transposition table is aged. Entries from finished games have to give up the deep
+// slots, but the workers' searches overlap, and ageing per job would leave every running search's entries
+// looking old whenever another worker started one.
+#define SERVER_TT_AGE_MS 1000
+
+struct SearchJob {
+    u64 sessionId;
+    Board board;
+    int budgetMs;
+    std::chrono::steady_clock::time_point queuedAt;
+};
+
+struct SearchJobResult {
+    u64 sessionId;
+    Move move;
+    double latencyMs;       // From submission to the move being ready
+};
+
+class WorkerPool {
+public:
+    WorkerPool(unsigned threadCount, size_t maxQueueDepth) : maxQueueDepth(maxQueueDepth) {
+        notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads) thread.join();
+        close(notifyFd);
+    }
+
+    // Becomes readable whenever results are waiting
+    int eventFd() const {
+        return notifyFd;
+    }
+
+    // Fails when the queue is already at its maximum depth
+    bool submit(const SearchJob &job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= maxQueueDepth) return false;
+            queue.push_back(job);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    std::vector<SearchJobResult> takeResults() {
+        u64 counter;
+        while (read(notifyFd, &counter, sizeof(counter)) > 0) {}
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        std::vector<SearchJobResult> taken;
+        taken.swap(results);
+        return taken;
+    }
+
+    size_t queueLength() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    unsigned busyWorkers() const {
+        return busy.load(std::memory_order_relaxed);
+    }
+
+    unsigned workerCount() const {
+        return static_cast<unsigned>(threads.size());
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<SearchJob> queue;
+    size_t maxQueueDepth;
+    bool stopping = false;
+
+    std::mutex resultMutex;
+    std::vector<SearchJobResult> results;
+    std::atomic<unsigned> busy{0};
+    int notifyFd;
+    std::atomic<int64_t> lastAged{0};   // Steady clock ticks at the table's last newSearch()
+
+    void run() {
+        // df-pn keeps its own table, so every worker has a solver of its own
+        DfpnSolver solver(16);
+
+        while (true) {
+            SearchJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+                job = queue.front();
+                queue.pop_front();
+            }
+
+            busy++;
+            ageTable();
+            Move move = search(solver, job);
+            busy--;
+
+            double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.queuedAt).count();
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                results.push_back(SearchJobResult{job.sessionId, move, latencyMs});
+            }
+
+            u64 one = 1;
+            if (write(notifyFd, &one, sizeof(one)) < 0) {}
+        }
+    }
+
+    // Whichever worker first finds the period over ages the table, so it ages once per period however
+    // many jobs start
+    void ageTable() {
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        int64_t last = lastAged.load(std::memory_order_relaxed);
+        int64_t period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::milliseconds(SERVER_TT_AGE_MS)).count();
+        if (now - last >= period && lastAged.compare_exchange_strong(last, now)) transpositionTable.newSearch();
+    }
+
+    // The budget counts from submission, so time spent in the queue comes out of the search
+    static Move search(DfpnSolver &solver, const SearchJob &job) {
+        auto moves = job.board.getValidMoves<PieceRange::Black>();
+
+#if DFPN_PRESEARCH
+        DfpnResult proof = solver.solve(job.board, PieceRange::Black, SERVER_DFPN_NODES);
+        if (proof.outcome == DfpnOutcome::Win && !proof.line.empty()) return proof.line[0];
+#else
+        (void) solver;
+#endif
+
+        SearchContext context;
+        context.verbose = false;
+        context.setDeadline(job.queuedAt + std::chrono::milliseconds(job.budgetMs));
+        return searchRoot(context, job.board, moves).bestMove;
+    }
+};
+
+// Rolling window of the most recent job latencies
+class LatencyStats {
+public:
+    static const size_t WINDOW = 4096;
+
+    void add(double latencyMs) {
+        if (samples.size() < WINDOW) {
+            samples.push_back(latencyMs);
+        } else {
+            samples[next] = latencyMs;
+        }
+        next = (next + 1) % WINDOW;
+        total++;
+    }
+
+    u64 count() const {
+        return total;
+    }
+
+    double percentile(double fraction) const {
+        if (samples.empty()) return 0;
+
+        std::vector<double> sorted(samples);
+        auto idx = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+        return sorted[idx];
+    }
+
+private:
+    std::vector<double> samples;
+    size_t next = 0;
+    u64 total = 0;
+};
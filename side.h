@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+#include "bitboard.h"
+#include "game.h"
+
+// Compile-time description of each side, so that move generation, move application and search are
+// written once and instantiated per colour. White moves up the board (towards higher squares) and
+// black moves down it; everything that differs between the two follows from that.
+template<PieceRange range>
+struct SideTraits;
+
+template<>
+struct SideTraits<PieceRange::White> {
+    static constexpr PieceRange opponent = PieceRange::Black;
+    static constexpr int index = 1;
+
+    static constexpr PieceType pawn   = WhitePawn;
+    static constexpr PieceType knight = WhiteKnight;
+    static constexpr PieceType rook   = WhiteRook;
+    static constexpr PieceType bishop = WhiteBishop;
+    static constexpr PieceType car    = WhiteCar;
+
+    // Pawns push by 8 and capture by 9 or 7; each capture shift has a mask for the column it can't land on
+    static constexpr u64 pawnCapture9Mask = leftColMask;
+    static constexpr u64 pawnCapture7Mask = rightColMask;
+
+    static constexpr u64 advance(u64 bits, unsigned shift) { return bits << shift; }
+    static constexpr u8 retreat(u8 square, unsigned shift) { return static_cast<u8>(square - shift); }
+    static constexpr bool isForward(u8 fromCell, u8 toCell) { return toCell > fromCell; }
+
+    // Rooks and bishops may slide freely forward, but only capture in the remaining directions
+    static constexpr ScanDirection rookForward = North;
+    static constexpr ScanDirection rookCaptures[3] = {East, West, South};
+    static constexpr ScanDirection bishopForward[2] = {NorthEast, NorthWest};
+    static constexpr ScanDirection bishopCaptures[2] = {SouthEast, SouthWest};
+
+    static constexpr u8 carPath[7] = {0, 9, 18, 27, 28, 29, 30};
+    static constexpr const char* name = "white";
+};
+
+template<>
+struct SideTraits<PieceRange::Black> {
+    static constexpr PieceRange opponent = PieceRange::White;
+    static constexpr int index = 0;
+
+    static constexpr PieceType pawn   = BlackPawn;
+    static constexpr PieceType knight = BlackKnight;
+    static constexpr PieceType rook   = BlackRook;
+    static constexpr PieceType bishop = BlackBishop;
+    static constexpr PieceType car    = BlackCar;
+
+    static constexpr u64 pawnCapture9Mask = rightColMask;
+    static constexpr u64 pawnCapture7Mask = leftColMask;
+
+    static constexpr u64 advance(u64 bits, unsigned shift) { return bits >> shift; }
+    static constexpr u8 retreat(u8 square, unsigned shift) { return static_cast<u8>(square + shift); }
+    static constexpr bool isForward(u8 fromCell, u8 toCell) { return toCell < fromCell; }
+
+    static constexpr ScanDirection rookForward = South;
+    static constexpr ScanDirection rookCaptures[3] = {East, West, North};
+    static constexpr ScanDirection bishopForward[2] = {SouthEast, SouthWest};
+    static constexpr ScanDirection bishopCaptures[2] = {NorthEast, NorthWest};
+
+    static constexpr u8 carPath[7] = {56, 49, 42, 35, 36, 37, 38};
+    static constexpr const char* name = "black";
+};
+
+constexpr PieceRange opponentOf(PieceRange range) {
+    return range == PieceRange::White? PieceRange::Black : PieceRange::White;
+}
+
+constexpr int sideIndex(PieceRange range) {
+    return range == PieceRange::White? SideTraits<PieceRange::White>::index : SideTraits<PieceRange::Black>::index;
+}
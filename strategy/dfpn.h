@@ -0,0 +1,27 @@
+#pragma once
+
+#include "strategy.h"
+#include "../dfpn.h"
+
+#define DFPN_NODE_BUDGET 2000000
+
+// Plays the proven winning move when df-pn finds one, otherwise the move it considers most promising
+Move getComputerMove(Board &board, MoveList &moves) {
+    static DfpnSolver solver(22);
+
+    DfpnResult result = solver.solve(board, PieceRange::Black, DFPN_NODE_BUDGET);
+    cout << "Searched " << result.nodes << " proof-number nodes." << endl;
+
+    if (result.outcome == DfpnOutcome::Win && !result.line.empty()) {
+        cout << "Proved a win in " << result.line.size() << " plies." << endl;
+        return result.line[0];
+    } else if (result.outcome == DfpnOutcome::Loss) {
+        cout << "Proved a loss." << endl;
+    }
+
+    Move move = solver.mostProvingMove(board, PieceRange::Black);
+    for (auto validMove : moves.moves) {
+        if (validMove == move) return validMove;
+    }
+    return moves[0];
+}
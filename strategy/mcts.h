@@ -1,152 +1,384 @@
 #pragma once
 
-#include <map>
-#include <deque>
+#include <algorithm>
 #include <chrono>
-#include <random>
+#include <cmath>
+#include <deque>
 #include <memory>
+#include <unordered_map>
 
 #include "strategy.h"
+#include "search.h"
+#include "../playout.h"
+#include "../rng.h"
 
 using std::unique_ptr;
 
-static auto rng = std::default_random_engine{};
+#define MCTS_SECONDS 5
+
+// The UCT exploration constant c; 1/sqrt(2) suits the 0-1 results of random playouts
+#ifndef MCTS_EXPLORATION
+#define MCTS_EXPLORATION 0.7071067811865475
+#endif
+
+// Hybrid mode: new leaves are scored by an alphabeta() search this deep, mapped to a win probability,
+// instead of by random playouts alone, which one capture of a car-path blocker can swing either way.
+// 0 scores leaves by playouts only.
+#define HYBRID_DEPTH 2
+
+// Whether a hybrid leaf also gets its batch of playouts, averaged with the search score. RAVE learns from
+// the moves of the playouts, so with it they are always played.
+#define HYBRID_PLAYOUTS false
+
+// Heuristic points for a factor of e in the odds of a black win; one car step is worth 200
+#define HYBRID_SCALE 300.0
+
+struct MctsSettings {
+    std::chrono::milliseconds budget{MCTS_SECONDS * 1000};
+    int leafDepth = HYBRID_DEPTH;
+    bool playouts = HYBRID_PLAYOUTS;
+    double exploration = MCTS_EXPLORATION;
+    bool verbose = true;
+    TraceWriter *trace = nullptr;       // Gets a record of every simulation if set
+};
+
+// A leaf's worth as black wins out of `PlayoutKernel::LANES` games, fractional when it comes from a search
+struct LeafValue {
+    double blackWins = 0;
+    bool playedOut = false;     // Whether the kernel's lanes hold this leaf's playouts
+};
+
+// Rapid action value estimation: every move a side plays later in a simulation also counts as if it had
+// been played first, so one playout informs every sibling edge it touched rather than just the path. Off
+// by default: in this game a move's worth depends too much on when it is played, and in self-play at
+// 50-1500 simulations per move it did not beat plain UCT.
+#ifndef RAVE
+#define RAVE false
+#endif
+
+// Playouts after which an edge's own statistics weigh about as much as its all-moves-as-first ones
+#define RAVE_EQUIVALENCE 100
+
+// Each simulation plays a batch of PlayoutKernel::LANES random games from the new leaf
+static PlayoutKernel playoutKernel;
+
+#if RAVE
+// Moves seen in the current lane of a simulation, indexed by piece, from and to square; a slot counts as
+// seen when it holds the current stamp, so nothing has to be cleared between lanes
+static u32 amafSeen[11 * 64 * 64];
+static u32 amafStamp = 0;
+
+inline u32& amafSlot(const Move &move) {
+    return amafSeen[(move.movingPiece * 64 + move.fromCell) * 64 + move.toCell];
+}
+#endif
 
 class Node {
 public:
     Board board;
-    PieceRange pieceRange;
-    Node* parent;
+    PieceRange pieceRange;  // Side to move here
 
     std::vector<Move> moves;
     std::deque<size_t> moveOrder;
-    std::map<Move, unique_ptr<Node>> children;
 
-    u32 winCount = 0;
+    // The positions after each of `moves`, null until expanded. A position reached by several move orders
+    // is one shared node, so nodes can have many parents; moves only go forward, so there are no cycles.
+    std::vector<Node*> children;
+    std::vector<u32> edgeVisits;
+    u32 edgeTotal = 0;
+
+    // Playouts through this node by any path and how many of them were won by the side that moved into
+    // it, so that a parent picks its best child by win rate. A leaf scored by a search counts as a batch
+    // of playouts.
+    double winCount = 0;
     u32 totalCount = 0;
 
-    Node(Board gameBoard, PieceRange nodeRange, Node* nodeParent = nullptr)
-        : board(gameBoard), pieceRange(nodeRange), parent(nodeParent) {
-        moves = gameBoard.getValidMoves(nodeRange);
+#if RAVE
+    // All-moves-as-first playouts and wins for the side to move, per entry of `moves`
+    std::vector<u32> amafWins;
+    std::vector<u32> amafTotals;
+#endif
+
+    Node(const Board &gameBoard, PieceRange nodeRange) : board(gameBoard), pieceRange(nodeRange) {
+        if (gameBoard.getGameState() == GameState::IsPlaying) {
+            moves = gameBoard.getValidMoves(nodeRange).moves;
+        }
 
         for (size_t i = 0; i < moves.size(); i++) {
             moveOrder.push_back(i);
         }
 
-        std::shuffle(moveOrder.begin(), moveOrder.end(), rng);
+        threadRng().shuffle(moveOrder.begin(), moveOrder.end());
+        children.assign(moves.size(), nullptr);
+        edgeVisits.assign(moves.size(), 0);
+
+#if RAVE
+        amafWins.assign(moves.size(), 0);
+        amafTotals.assign(moves.size(), 0);
+#endif
     }
 
     inline bool explored() { return moveOrder.empty(); }
 
-    Node* treePolicy() {
-        //cout << "Tree Policy" << endl;
-        Node* v = this;
+    // The next move to expand, taken off moveOrder
+    size_t nextUnexpanded() {
+#if RAVE
+        // Try the move with the best all-moves-as-first rate next; moves never seen count as even
+        auto next = moveOrder.end() - 1;
+        double nextValue = -1;
+        for (auto it = moveOrder.begin(); it != moveOrder.end(); ++it) {
+            double value = amafTotals[*it] > 0? static_cast<double>(amafWins[*it]) / amafTotals[*it] : 0.5;
+            if (value > nextValue) {
+                next = it;
+                nextValue = value;
+            }
+        }
+        std::iter_swap(next, moveOrder.end() - 1);
+#endif
 
-        while (!v->moves.empty()) {
-            if (v->explored()) {
-                //cout << "Explored path" << endl;
-                v = v->bestChild().second;
-                //cout << "V board:" << endl << v->board << endl;
-            } else {
-                //cout << "V unexplored." << endl;
-                return v->expand();
+        size_t index = moveOrder.back();
+        moveOrder.pop_back();
+        return index;
+    }
+
+    // UCT over the edges: the child's pooled win rate, explored by how often this edge was taken
+    size_t bestChild(double c) {
+        size_t best = 0;
+        double bestValue = -1;
+        double logVisits = log(static_cast<double>(edgeTotal));
+
+        for (size_t i = 0; i < moves.size(); i++) {
+            if (!children[i]) continue;
+
+            double childValue = children[i]->baseValue();
+#if RAVE
+            // Lean on the all-moves-as-first rate while the edge's own count is small
+            if (amafTotals[i] > 0) {
+                double beta = sqrt(RAVE_EQUIVALENCE / (3.0 * edgeVisits[i] + RAVE_EQUIVALENCE));
+                childValue = (1 - beta) * childValue + beta * amafWins[i] / amafTotals[i];
+            }
+#endif
+            childValue += c * sqrt((2 * logVisits) / edgeVisits[i]);
+
+            if (childValue > bestValue) {
+                best = i;
+                bestValue = childValue;
             }
         }
 
-        return v;
+        return best;
     }
 
-    Node* expand() {
-        Move move = moves[moveOrder.back()];
-        //cout << "Move idx: " << moveOrder.back() << endl << "Move chosen: " << move << endl;
-        moveOrder.pop_back();
+    LeafValue defaultPolicy(SearchContext &context, const MctsSettings &settings) {
+        LeafValue value;
 
-        Board boardCopy(board);
-        PieceRange oppositeRange;
-        if (pieceRange == PieceRange::White) {
-            boardCopy.performWhiteMove(move);
-            oppositeRange = PieceRange::Black;
-        } else {
-            boardCopy.performBlackMove(move);
-            oppositeRange = PieceRange::White;
+        if (settings.leafDepth == 0 || settings.playouts || RAVE) {
+            playoutKernel.recordMoves = RAVE;
+            value.blackWins = playoutKernel.run(board, pieceRange).blackWins;
+            value.playedOut = true;
         }
 
-        children.insert(std::make_pair(move, unique_ptr<Node>(new Node(boardCopy, oppositeRange))));
-        return children[move].get();
+        if (settings.leafDepth > 0) {
+#if NNUE
+            context.nnueRoot(board);
+#endif
+            int score = pieceRange == PieceRange::Black? alphabeta<PieceRange::Black>(context, board, settings.leafDepth, INT_MIN, INT_MAX)
+                                                       : alphabeta<PieceRange::White>(context, board, settings.leafDepth, INT_MIN, INT_MAX);
+            double blackWins = PlayoutKernel::LANES * winProbability(score);
+            value.blackWins = value.playedOut? (value.blackWins + blackWins) / 2 : blackWins;
+        }
+
+        return value;
     }
 
-    std::pair<Move, Node*> bestChild(double c = 0.7071067811865475) {
-        // Default value of c (the exploration constant) is 1/sqrt(2)
-        std::pair<Move, Node*> bestPair;
-        double bestValue = -1;
+    // Black's chance of winning given a search score from black's point of view
+    static double winProbability(int score) {
+        if (score >= WIN_THRESHOLD) return 1.0;
+        if (score <= -WIN_THRESHOLD) return 0.0;
+        return 1.0 / (1.0 + exp(-score / HYBRID_SCALE));
+    }
+
+    double inline baseValue() {
+        if (totalCount == 0) return 0.0;
+        return winCount / totalCount;
+    }
+};
 
-        for (auto &pair : children) {
-            Node* child = pair.second.get();
+// One step of a walk from the root: a node and the index of the move taken from it, -1 at the leaf
+struct PathStep {
+    Node* node;
+    int moveIndex;
+};
 
-            double childValue = child->baseValue();
-            childValue += c * sqrt((2 * log(child->totalCount)) / child->totalCount);
+// The search graph, owning every node by its position's hash with the side to move, so transpositions
+// share one node and pool their statistics. Statistics are updated along the path a simulation took,
+// which visits every node at most once since the graph has no cycles.
+class MctsGraph {
+public:
+    Node* root;
+    u64 transpositions = 0;     // Expansions that found their position already in the graph
 
-            if (childValue > bestValue) {
-                bestPair = std::make_pair(pair.first, pair.second.get());
-                bestValue = childValue;
+    MctsGraph(const Board &board, PieceRange range) {
+        root = nodeFor(board, range);
+    }
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+    // Walks down by UCT until it expands an edge or reaches a finished game
+    void select(double exploration, std::vector<PathStep> &path) {
+        path.clear();
+        Node* v = root;
+
+        // Finished games have no moves, so the walk stops on them
+        while (!v->moves.empty()) {
+            size_t index;
+            if (v->explored()) {
+                index = v->bestChild(exploration);
+            } else {
+                index = v->nextUnexpanded();
+                Board boardCopy(v->board);
+                boardCopy.performMove(v->pieceRange, v->moves[index]);
+                v->children[index] = nodeFor(boardCopy, opponentOf(v->pieceRange));
             }
+
+            path.push_back(PathStep{v, static_cast<int>(index)});
+            v = v->children[index];
+
+            // A new node is the leaf; a transposition already has statistics, so the walk carries on
+            if (v->totalCount == 0) break;
         }
 
-        return bestPair;
+        path.push_back(PathStep{v, -1});
     }
 
-    GameState defaultPolicy() {
-        Board currentBoard(board);
-        PieceRange boardRange = pieceRange;
+    void backpropagation(const std::vector<PathStep> &path, const LeafValue &value) {
+        for (const auto &step : path) {
+            Node* node = step.node;
 
-        cout << "Default policy: range " << (int)boardRange << endl;
+            // The side that moved into a node is the one not to move in it
+            node->winCount += node->pieceRange == PieceRange::Black? PlayoutKernel::LANES - value.blackWins : value.blackWins;
+            node->totalCount += PlayoutKernel::LANES;
 
-        while (currentBoard.getGameState() == GameState::IsPlaying) {
-            auto currentMoves = currentBoard.getValidMoves(boardRange);
-            auto chosenMove = currentMoves[rand() % currentMoves.size()];
-
-            if (boardRange == PieceRange::White) {
-                currentBoard.performWhiteMove(chosenMove);
-                boardRange = PieceRange::Black;
-            } else {
-                currentBoard.performBlackMove(chosenMove);
-                boardRange = PieceRange::White;
+            if (step.moveIndex >= 0) {
+                node->edgeVisits[step.moveIndex] += PlayoutKernel::LANES;
+                node->edgeTotal += PlayoutKernel::LANES;
             }
         }
 
-        return currentBoard.getGameState();
+#if RAVE
+        if (!value.playedOut) return;
+        for (int lane = 0; lane < PlayoutKernel::LANES; lane++) {
+            updateAmaf(path, playoutKernel.movesPlayed(lane), playoutKernel.laneOutcome(lane));
+        }
+#endif
     }
 
-    void backpropagation(GameState outcome) {
-        Node* currentNode = this;
+#if RAVE
+    // Walks the path from the leaf to the root; at every node, each move that its side to move went on to
+    // play further down the path or in the playout counts for that move's edge. Pieces carry their
+    // colour, so a move can only be matched by the side that played it.
+    static void updateAmaf(const std::vector<PathStep> &path, const std::vector<Move> &playoutMoves, GameState outcome) {
+        amafStamp++;
+        for (const Move &playoutMove : playoutMoves) {
+            amafSlot(playoutMove) = amafStamp;
+        }
+
+        for (size_t i = path.size(); i-- > 0;) {
+            Node* node = path[i].node;
+            bool won = (outcome == GameState::BlackWins) == (node->pieceRange == PieceRange::Black);
 
-        while (currentNode) {
-            if ((currentNode->pieceRange == PieceRange::White && outcome == GameState::WhiteWins)
-            ||  (currentNode->pieceRange == PieceRange::Black && outcome == GameState::BlackWins)) {
-                currentNode->winCount++;
+            for (size_t j = 0; j < node->moves.size(); j++) {
+                if (amafSlot(node->moves[j]) == amafStamp) {
+                    node->amafTotals[j]++;
+                    node->amafWins[j] += won;
+                }
             }
-            currentNode->totalCount++;
-            currentNode = currentNode->parent;
+
+            if (i > 0) amafSlot(path[i - 1].node->moves[path[i - 1].moveIndex]) = amafStamp;
         }
     }
+#endif
 
-    double inline baseValue() {
-        if (totalCount == 0) return 0.0;
-        return static_cast<double>(winCount) / totalCount;
+    // The node for a position, created the first time it is reached
+    Node* nodeFor(const Board &board, PieceRange range) {
+        auto &node = nodes[board.hash(range)];
+        if (node) {
+            transpositions++;
+        } else {
+            node.reset(new Node(board, range));
+        }
+        return node.get();
     }
+
+private:
+    std::unordered_map<u64, unique_ptr<Node>> nodes;
 };
 
-Move getComputerMove(Board &board, std::vector<Move> &moves) {
-    std::chrono::time_point<std::chrono::system_clock> stopTime;
-    stopTime = std::chrono::system_clock::now() + std::chrono::seconds(5);
-    Node root = Node(board, PieceRange::Black);
+// Runs MCTS from the root of `graph` until the budget is spent and returns the most visited move
+Move searchMcts(MctsGraph &graph, const MctsSettings &settings) {
+    auto stopTime = std::chrono::steady_clock::now() + settings.budget;
+    Node* root = graph.root;
+    if (root->moves.size() == 1) return root->moves[0];
+
+    SearchContext context;
+    context.verbose = false;
+    if (settings.leafDepth > 0) transpositionTable.newSearch();
+    playoutKernel.seed(threadRng().next());
+
+    u64 simulations = 0;
+    std::vector<PathStep> path;
+#if SEARCH_TRACE
+    if (settings.trace) settings.trace->record(TraceRecord{TraceKind::Search, 0, 0, 0, 0, 0, TRACE_NO_CUTOFF, 0, 0, 0, 0, 0});
+#endif
+    while (std::chrono::steady_clock::now() < stopTime) {
+        graph.select(settings.exploration, path);
+#if SEARCH_TRACE
+        const u64 traceNodes = context.nodesEvaluated;
+#endif
+        LeafValue value = path.back().node->defaultPolicy(context, settings);
+        graph.backpropagation(path, value);
+        simulations++;
+
+#if SEARCH_TRACE
+        if (settings.trace) {
+            TraceRecord record{TraceKind::Simulation, static_cast<uint8_t>(std::min<size_t>(path.size() - 1, 255)), 0, 0, 0, 0,
+                               TRACE_NO_CUTOFF, 0, 0, 0, static_cast<int32_t>(value.blackWins * 1000 / PlayoutKernel::LANES),
+                               static_cast<uint32_t>(context.nodesEvaluated - traceNodes)};
+            if (path.size() > 1) record.setMove(root->moves[path[0].moveIndex]);
+            settings.trace->record(record);
+        }
+#endif
+    }
 
-    //while (std::chrono::system_clock::now() < stopTime) {
-        Node* expandedNode = root.treePolicy();
-        //cout << "After TreePolicy: " << endl << expandedNode->board << endl;
-        GameState outcome = expandedNode->defaultPolicy();
-        expandedNode->backpropagation(outcome);
-    //}
+    // The most visited move is the one the search trusts most
+    size_t mostVisited = std::max_element(root->edgeVisits.begin(), root->edgeVisits.end()) - root->edgeVisits.begin();
+
+    if (settings.verbose) {
+        cout << "Ran " << simulations << " simulations";
+        if (settings.leafDepth > 0) cout << " with depth " << settings.leafDepth << " leaf searches";
+        // A budget that ran out before the first simulation leaves no child to take a win rate from
+        if (root->children[mostVisited]) {
+            cout << ", win rate " << static_cast<int>(root->children[mostVisited]->baseValue() * 100) << "%";
+        }
+        cout << "." << endl;
+        cout << graph.size() << " nodes, " << graph.transpositions << " transpositions." << endl;
+    }
+    return root->moves[mostVisited];
+}
+
+// Runs MCTS for `range` until the budget is spent and returns the most visited move
+Move searchMcts(const Board &board, PieceRange range, const MctsSettings &settings) {
+    MctsGraph graph(board, range);
+    return searchMcts(graph, settings);
+}
 
-    return root.bestChild(0).first;
+Move getComputerMove(Board &board, MoveList &moves) {
+    if (moves.size() == 1) return moves[0];
+    MctsSettings settings;
+#if SEARCH_TRACE
+    if (searchTrace.isOpen()) settings.trace = &searchTrace;
+#endif
+    return searchMcts(board, PieceRange::Black, settings);
 }
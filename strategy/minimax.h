@@ -1,177 +1,167 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
+#include <iomanip>
+#include <string>
+#include <thread>
 
 #include "strategy.h"
+#include "search.h"
+#include "../dfpn.h"
 
-#define AB_PRUNING true
-#define STATS true
+#define DFPN_PRESEARCH true
+#define DFPN_PRESEARCH_NODES 50000
+#define PONDERING true
+#define SEARCH_SECONDS 5
 
-#if STATS
-static u64 nodesEvaluated = 0;
-static u64 branchNum = 0;
-static u64 branchDenom = 0;
-#endif
+// Lines reported by analysePosition() unless asked for another number
+#define ANALYSIS_LINES 3
 
-static std::chrono::time_point<std::chrono::system_clock> stopTime;
-
-inline int scorePieces(const Board &board, PieceRange range) {
-    int score = 0;
-
-    if (range == PieceRange::White) {
-        score += __builtin_popcountll(board.whitePawns.bits) * 10;
-        score += __builtin_popcountll(board.whiteKnights.bits) * 40;
-        score += __builtin_popcountll(board.whiteRooks.bits) * 35;
-        score += __builtin_popcountll(board.whiteBishops.bits) * 30;
-        score += (__builtin_ctzll(board.whiteCar.bits) % 8) * 200;
-    } else {
-        score += __builtin_popcountll(board.blackPawns.bits) * 10;
-        score += __builtin_popcountll(board.blackKnights.bits) * 40;
-        score += __builtin_popcountll(board.blackRooks.bits) * 35;
-        score += __builtin_popcountll(board.blackBishops.bits) * 30;
-        score += (__builtin_ctzll(board.blackCar.bits) % 8) * 200;
+Move getComputerMove(Board &board, MoveList &moves) {
+#if DFPN_PRESEARCH
+    // Settle forced car races with a small proof-number search before spending a full time slice
+    static DfpnSolver solver;
+    DfpnResult proof = solver.solve(board, PieceRange::Black, DFPN_PRESEARCH_NODES);
+    if (proof.outcome == DfpnOutcome::Win && !proof.line.empty()) {
+        cout << "Proved a win in " << proof.line.size() << " plies (" << proof.nodes << " nodes)." << endl;
+        return proof.line[0];
     }
+#endif
 
-    return score;
-}
+    auto startTime = std::chrono::steady_clock::now();
+    transpositionTable.newSearch();
+    SearchContext context;
+    context.setDeadline(startTime + std::chrono::seconds(SEARCH_SECONDS));
+#if SEARCH_TRACE
+    if (searchTrace.isOpen()) context.trace = &searchTrace;
+#endif
+
+    SearchResult result = searchRoot(context, board, moves);
+
+    cout << endl << endl;
+    printSearchStats(context, startTime);
 
-int heuristic(const Board &board) {
-    int blackScore = scorePieces(board, PieceRange::Black);
-    int whiteScore = scorePieces(board, PieceRange::White);
-    return blackScore - whiteScore;
+    return result.bestMove;
 }
 
-int minimax(const Board &board, const MoveList &moves, bool maximizingPlayer, int depth) {
-    if (board.getGameState() == GameState::BlackWins) {
-        return 10000000 + depth;
-    } else if (board.getGameState() == GameState::WhiteWins) {
-        return -10000000 - depth;
-    } else if (depth == 0 || std::chrono::system_clock::now() > stopTime) {
-        return heuristic(board);
+// Multi-PV analysis for review: prints the best `lines` moves of the position in `text` (board notation,
+// see boardToString()) with their scores from the side to move's point of view and their variations.
+// Searches for SEARCH_SECONDS, or to `maxDepth` if that is given.
+int analysePosition(const std::string &text, size_t lines, int maxDepth = 0) {
+    Board board;
+    PieceRange range;
+    if (!parseBoard(text, board, range)) {
+        cout << "Not a position: " << text << endl;
+        return 1;
     }
-
-    int bestValue = maximizingPlayer? INT_MIN : INT_MAX;
-
-    for (const auto &move : moves.moves) {
-        Board boardCopy(board);
-        if (maximizingPlayer) {
-            boardCopy.performBlackMove(move);
-            auto newMoves = boardCopy.getValidMoves(PieceRange::White);
-            int nodeValue = minimax(boardCopy, newMoves, !maximizingPlayer, depth - 1);
-            if (nodeValue > bestValue) bestValue = nodeValue;
-        } else {
-            boardCopy.performWhiteMove(move);
-            auto newMoves = boardCopy.getValidMoves(PieceRange::Black);
-            int nodeValue = minimax(boardCopy, newMoves, !maximizingPlayer, depth - 1);
-            if (nodeValue < bestValue) bestValue = nodeValue;
-        }
+    if (board.getGameState() != GameState::IsPlaying) {
+        cout << "The game is over." << endl;
+        return 1;
     }
 
-    return bestValue;
+    auto startTime = std::chrono::steady_clock::now();
+    transpositionTable.newSearch();
+    SearchContext context;
+    context.verbose = false;
+    if (maxDepth == 0) context.setDeadline(startTime + std::chrono::seconds(SEARCH_SECONDS));
+
+    auto moves = board.getValidMoves(range);
+    int depthLimit = maxDepth > 0? maxDepth : 64;
+    SearchResult result = range == PieceRange::Black? searchMultiPv<PieceRange::Black>(context, board, moves, lines, depthLimit)
+                                                     : searchMultiPv<PieceRange::White>(context, board, moves, lines, depthLimit);
+
+    cout << "Depth " << result.depth << endl;
+    for (size_t i = 0; i < result.lines.size(); i++) {
+        const PvLine &line = result.lines[i];
+        cout << i + 1 << ". " << line.move << std::setw(10) << (range == PieceRange::Black? line.score : -line.score) << " ";
+        for (const auto &move : line.pv) cout << ' ' << move;
+        cout << endl;
+    }
+    printSearchStats(context, startTime);
+    return 0;
 }
 
-int alphabeta(const Board &board, int depth, int alpha, int beta, bool maximizingPlayer) {
-    if (unlikely(board.getGameState() == GameState::BlackWins)) {
-#if STATS
-        nodesEvaluated++;
-#endif
-        return 10000000 + depth;
-    } else if (unlikely(board.getGameState() == GameState::WhiteWins)) {
-#if STATS
-        nodesEvaluated++;
-#endif
-        return -10000000 - depth;
-    } else if (likely(depth == 0) || std::chrono::system_clock::now() > stopTime) {
-#if STATS
-        nodesEvaluated++;
-#endif
-        return heuristic(board);
+#if PONDERING
+// Searches on the player's time. After the computer moves, the player's reply is predicted from the
+// transposition table and the position after it is searched on a background thread until the player
+// has chosen. On a hit that search just carries on to the usual deadline, counted from when pondering
+// started; on a miss it is cancelled, and whatever it put in the table helps the search that follows.
+class Ponderer {
+public:
+    ~Ponderer() {
+        cancel();
     }
 
-    if (maximizingPlayer) {
-        int bestValue = INT_MIN;
-        auto moves = board.getValidMoves(PieceRange::Black);
-#if STATS
-        branchNum += moves.moves.size();
-        branchDenom++;
-#endif
-
-        std::swap(moves.moves[0], moves.moves[moves.carIdx]);
-        for (auto move : moves.moves) {
-            Board boardCopy(board);
-            boardCopy.performBlackMove(move);
-            int nodeValue = alphabeta(boardCopy, depth - 1, alpha, beta, false);
-            if (nodeValue > bestValue) bestValue = nodeValue;
-            if (nodeValue > alpha) alpha = nodeValue;
-            if (alpha >= beta) break;
-        }
-        return bestValue;
-    } else {
-        int bestValue = INT_MAX;
-        auto moves = board.getValidMoves(PieceRange::White);
-#if STATS
-        branchNum += moves.moves.size();
-        branchDenom++;
-#endif
-        std::swap(moves.moves[0], moves.moves[moves.carIdx]);
-        for (auto move : moves.moves) {
-            Board boardCopy(board);
-            boardCopy.performWhiteMove(move);
-            int nodeValue = alphabeta(boardCopy, depth - 1, alpha, beta, true);
-            if (nodeValue < bestValue) bestValue = nodeValue;
-            if (nodeValue < beta) beta = nodeValue;
-            if (alpha >= beta) break;
-        }
-        return bestValue;
+    // `board` is the position after the computer's move, with the player to move
+    void start(const Board &board) {
+        cancel();
+        haveReply = false;
+
+        TTEntry entry;
+        if (board.getGameState() != GameState::IsPlaying
+            || !probeTable(board, PieceRange::White, entry)) return;
+
+        auto playerMoves = board.getValidMoves<PieceRange::White>();
+        auto predictedMove = std::find_if(playerMoves.moves.begin(), playerMoves.moves.end(),
+                                          [&](const Move &move) { return move == entry.bestMove; });
+        if (predictedMove == playerMoves.moves.end()) return;
+
+        predicted = *predictedMove;
+        ponderBoard = board;
+        ponderBoard.performMove<PieceRange::White>(predicted);
+        if (ponderBoard.getGameState() != GameState::IsPlaying) return;
+        ponderMoves = ponderBoard.getValidMoves<PieceRange::Black>();
+
+        context.stop.store(false);
+        context.setDeadline(SearchContext::Clock::time_point::max());
+        context.verbose = false;
+        context.nodesEvaluated = context.branchNum = context.branchDenom = 0;
+        startTime = std::chrono::steady_clock::now();
+        transpositionTable.newSearch();
+
+        thread = std::thread([this]() { result = searchRoot(context, ponderBoard, ponderMoves); });
     }
-}
 
-Move getComputerMove(Board &board, MoveList &moves) {
-    Move bestMove{PieceType::EmptyPiece, 0, 0};
-    int bestValue = INT_MIN;
+    // Called with the player's move before it is played
+    void finish(const Move &playerMove) {
+        if (!thread.joinable()) return;
 
-#if STATS
-    nodesEvaluated = 0;
-    branchNum = 0;
-    branchDenom = 0;
-    auto startTime = std::chrono::steady_clock::now();
-#endif
-
-    stopTime = std::chrono::system_clock::now() + std::chrono::seconds(5);
-
-    int depth = 1;
-    while (stopTime > std::chrono::system_clock::now()) {
-        cout << "Calculating at depth " << ++depth << '\r' << flush;
-        for (const auto &move : moves.moves) {
-            Board boardCopy(board);
-            boardCopy.performBlackMove(move);
-#if AB_PRUNING
-            int value = alphabeta(boardCopy, depth, INT_MIN, INT_MAX, false);
-#else
-            int value = minimax(boardCopy, newMoves, false, depth);
-#endif
-            if (value > bestValue && stopTime > std::chrono::system_clock::now()) {
-                bestMove = move;
-                bestValue = value;
-            }
+        if (!(playerMove == predicted)) {
+            cancel();
+            return;
         }
-    }
-
-    cout << endl << endl;
 
-#if STATS
-    auto endTime = std::chrono::steady_clock::now();
-    auto diffTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-    auto diffTimeSc = diffTimeMs / 1000.0;
+        context.setDeadline(startTime + std::chrono::seconds(SEARCH_SECONDS));
+        thread.join();
+        haveReply = true;
 
-    cout << "Evaluated " << nodesEvaluated << " nodes in " << diffTimeMs << "ms." << endl;
+        cout << "Ponder hit, searched to depth " << result.depth << " while waiting." << endl;
+        printSearchStats(context, startTime);
+    }
 
-    auto nodesInFive = (nodesEvaluated / diffTimeSc) * 5;
-    cout << "Nodes in 5: " << nodesInFive << endl;
+    // The computer's reply prepared by a ponder hit, if there is one
+    bool takeReply(Move &reply) {
+        if (!haveReply) return false;
+        haveReply = false;
+        reply = result.bestMove;
+        return true;
+    }
 
-    auto avgBranches = branchDenom > 0? branchNum / branchDenom : 0;
-    cout << "Avg branches: " << avgBranches << endl;
+private:
+    std::thread thread;
+    SearchContext context;
+    std::chrono::steady_clock::time_point startTime;
+    Board ponderBoard;
+    MoveList ponderMoves{{}};
+    Move predicted{PieceType::EmptyPiece, 0, 0};
+    SearchResult result;
+    bool haveReply = false;
+
+    void cancel() {
+        if (!thread.joinable()) return;
+        context.stop.store(true);
+        thread.join();
+    }
+};
 #endif
-
-    return bestMove;
-}
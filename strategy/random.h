@@ -1,9 +1,8 @@
 #pragma once
 
-#include <random>
-
 #include "strategy.h"
+#include "../rng.h"
 
 Move getComputerMove(Board &board, MoveList &moves) {
-    return moves.moves[rand() % moves.moves.size()]; // NOLINT(cert-msc50-c,cert-msc30-c,cert-msc50-cpp)
+    return moves.moves[threadRng().below(static_cast<uint32_t>(moves.moves.size()))];
 }
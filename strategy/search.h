@@ -0,0 +1,741 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <limits>
+#include <vector>
+
+#include "strategy.h"
+#include "weights.h"
+#include "../nnue.h"
+#include "../race.h"
+#include "../structure.h"
+#include "../trace.h"
+#include "../tt.h"
+
+// The alpha-beta search itself, shared by the minimax strategy and by MCTS for scoring its leaves
+
+using std::flush;
+
+#define AB_PRUNING true
+#define STATS true
+#define RACE_RESOLVER true
+#define TRANSPOSITION_TABLE true
+#define TT_FILE_BITS 22
+
+// A position and its mirror image with the other side to move share one table entry, unless a network
+// that may score them differently is loaded
+#define SYMMETRIC_TT true
+
+// At the horizon captures are played out before the heuristic is trusted, so a search never stops
+// halfway through an exchange
+#define QUIESCENCE true
+
+// Heuristic points a capture may be worth beyond the piece it takes, for delta pruning
+#define QS_DELTA_MARGIN 50
+
+// Captures played out beyond the horizon. Pieces here capture in every direction, so unbounded capture
+// chains cost up to 50 times the nodes of the main search; a capture and its recapture settle most of
+// the swing for about twice the nodes.
+#define QS_MAX_PLIES 2
+
+// Adds the pawn skeleton's hold on the car roads from structure.h to the heuristic
+#define STRUCTURE_EVAL true
+
+// Lets a search record its tree into a TraceWriter (see trace.h); searches without one are unaffected
+#define SEARCH_TRACE true
+
+// Plies of the line being searched that the neural evaluation keeps an accumulator for: the deepest
+// iteration, the captures beyond it and the root
+#define NNUE_MAX_PLY 80
+
+static const int WIN_SCORE = 10000000;
+static const int WIN_THRESHOLD = WIN_SCORE - 1000;
+
+// State of a single search. The stop flag and the deadline may be changed by another thread while the
+// search runs, which is how pondering is cancelled or given a time limit.
+struct SearchContext {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<bool> stop{false};
+    std::atomic<Clock::rep> deadline{std::numeric_limits<Clock::rep>::max()};
+    bool verbose = true;
+
+    u64 nodesEvaluated = 0;
+    u64 branchNum = 0;
+    u64 branchDenom = 0;
+    u64 pollCount = 0;
+
+#if SEARCH_TRACE
+    TraceWriter *trace = nullptr;
+    int traceRootDepth = 0;     // The depth alphabeta() was given at ply 0, to tell the ply from the depth
+    Move tracePath[80];         // The moves that led to each ply
+
+    int tracePly(int depth) const {
+        return traceRootDepth - depth;
+    }
+#endif
+
+#if NNUE
+    // First layer of the neural evaluation for each position along the line being searched. It lives
+    // here rather than in Board, so that the board copies made at every node stay small.
+    NnueAccumulator nnueStack[NNUE_MAX_PLY];
+    int nnuePly = 0;
+
+    // Starts the stack at the position a search begins from
+    void nnueRoot(const Board &board) {
+        nnuePly = 0;
+        if (nnueLoaded) nnueStack[0].refresh(board.pieces);
+    }
+
+    // One ply down the line, by `move` from `board`, which it hasn't been played on yet
+    void nnuePush(const Board &board, const Move &move) {
+        if (!nnueLoaded) return;
+        NnueAccumulator &next = nnueStack[nnuePly + 1];
+        next = nnueStack[nnuePly];
+        PieceType captured = board.pieceAt(move.toCell);
+        if (captured != EmptyPiece) next.remove(captured, move.toCell);
+        next.move(move.movingPiece, move.fromCell, move.toCell);
+        nnuePly++;
+    }
+
+    void nnuePop() {
+        if (nnueLoaded) nnuePly--;
+    }
+#endif
+
+    void setDeadline(Clock::time_point time) {
+        deadline.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    bool stopped() const {
+        return stop.load(std::memory_order_relaxed);
+    }
+
+    // Called at every node; the clock is only read every 1024 calls
+    bool shouldStop() {
+        if (stopped()) return true;
+        if ((++pollCount & 1023u) == 0 && Clock::now().time_since_epoch().count() > deadline.load(std::memory_order_relaxed)) {
+            stop.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+};
+
+// A root move with its exact score and the line the search expects to follow it
+struct PvLine {
+    Move move;
+    int score;
+    std::vector<Move> pv;   // Starts with `move`
+};
+
+struct SearchResult {
+    Move bestMove{PieceType::EmptyPiece, 0, 0};
+    int score = INT_MIN;
+    int depth = 0;      // Deepest iteration that completed
+    std::vector<PvLine> lines;  // Best first, from searchMultiPv() only
+};
+
+// Shared by every search, including the ponder thread
+static TranspositionTable transpositionTable;
+
+// Everything the scores in the table depend on besides the position: the weights, the switches that
+// change what a search returns and the loaded network, if any. A table file written under another
+// fingerprint is started afresh, so a network has to be loaded before the file is opened.
+inline u64 evaluationFingerprint() {
+    u64 fingerprint = C64(0xCBF29CE484222325);
+    auto add = [&](const void *data, size_t size) {
+        for (size_t i = 0; i < size; i++) fingerprint = (fingerprint ^ static_cast<const u8*>(data)[i]) * C64(0x100000001B3);
+    };
+    const int switches[] = {RACE_RESOLVER, QUIESCENCE, QS_MAX_PLIES, QS_DELTA_MARGIN, STRUCTURE_EVAL, CAR_COLUMN_VALUE};
+    add(switches, sizeof(switches));
+    add(PIECE_VALUES, sizeof(PIECE_VALUES));
+#if STRUCTURE_EVAL
+    add(ROAD_BLOCKER, sizeof(ROAD_BLOCKER));
+    add(ROAD_CONTESTED, sizeof(ROAD_CONTESTED));
+#endif
+#if NNUE
+    if (nnueLoaded) {
+        add(nnueNetwork.featureWeights, sizeof(nnueNetwork.featureWeights));
+        add(nnueNetwork.featureBiases, sizeof(nnueNetwork.featureBiases));
+        add(nnueNetwork.outputWeights, sizeof(nnueNetwork.outputWeights));
+        add(&nnueNetwork.outputBias, sizeof(nnueNetwork.outputBias));
+        return fingerprint;
+    }
+#endif
+    add("no network", 10);
+    return fingerprint;
+}
+
+inline bool openTableFile(const std::string &path, unsigned tableBits) {
+    return transpositionTable.openFile(path, tableBits, evaluationFingerprint());
+}
+
+#if SEARCH_TRACE
+// Where the game's own searches record themselves, once opened; pondering is never traced
+static TraceWriter searchTrace;
+#endif
+
+// Win scores count the remaining depth, so they are stored relative to the node that produced them
+inline int scoreToTable(int score, int depth) {
+    if (score >= WIN_THRESHOLD) return score - depth;
+    if (score <= -WIN_THRESHOLD) return score + depth;
+    return score;
+}
+
+inline int scoreFromTable(int score, int depth) {
+    if (score >= WIN_THRESHOLD) return score + depth;
+    if (score <= -WIN_THRESHOLD) return score - depth;
+    return score;
+}
+
+// The key a position is kept under. The rules treat a position and its mirror image alike, but a loaded
+// network needn't score them alike, so with one the two keep entries of their own. Those are also set
+// apart from the built-in evaluation's, in case a network is loaded once the table has entries; a table
+// file takes care of that itself, see evaluationFingerprint().
+inline u64 tableKey(const Board &board, PieceRange range, bool &mirrored) {
+#if NNUE
+    if (nnueLoaded) {
+        mirrored = false;
+        return board.hash(range) ^ C64(0x9E3779B97F4A7C15);
+    }
+#endif
+    return board.canonicalHash(range, mirrored);
+}
+
+// Table access for a position. Scores in the table are black's, so an entry stored for the mirror image
+// comes back with the sign turned, the bound the other way round and its move mirrored.
+inline bool probeTable(const Board &board, PieceRange range, TTEntry &entry) {
+#if SYMMETRIC_TT
+    bool mirrored;
+    if (!transpositionTable.probe(tableKey(board, range, mirrored), entry)) return false;
+    if (mirrored) {
+        entry.score = -entry.score;
+        entry.bound = entry.bound == Bound::Lower? Bound::Upper : entry.bound == Bound::Upper? Bound::Lower : entry.bound;
+        entry.bestMove = entry.bestMove.mirror();
+    }
+    return true;
+#else
+    return transpositionTable.probe(board.hash(range), entry);
+#endif
+}
+
+inline void storeTable(const Board &board, PieceRange range, int score, int depth, Bound bound, Move move) {
+#if SYMMETRIC_TT
+    bool mirrored;
+    u64 key = tableKey(board, range, mirrored);
+    if (mirrored) {
+        score = -score;
+        bound = bound == Bound::Lower? Bound::Upper : bound == Bound::Upper? Bound::Lower : bound;
+        move = move.mirror();
+    }
+    transpositionTable.store(key, score, depth, bound, move);
+#else
+    transpositionTable.store(board.hash(range), score, depth, bound, move);
+#endif
+}
+
+template<PieceRange range>
+inline int scorePieces(const Board &board) {
+    using Side = SideTraits<range>;
+    int score = 0;
+
+    score += __builtin_popcountll(board.pieces[Side::pawn]) * PIECE_VALUES[Side::pawn];
+    score += __builtin_popcountll(board.pieces[Side::knight]) * PIECE_VALUES[Side::knight];
+    score += __builtin_popcountll(board.pieces[Side::rook]) * PIECE_VALUES[Side::rook];
+    score += __builtin_popcountll(board.pieces[Side::bishop]) * PIECE_VALUES[Side::bishop];
+    score += (__builtin_ctzll(board.pieces[Side::car]) % 8) * CAR_COLUMN_VALUE;
+
+    return score;
+}
+
+// The built-in evaluation, which a loaded network replaces
+int handcraftedHeuristic(const Board &board) {
+    int blackScore = scorePieces<PieceRange::Black>(board);
+    int whiteScore = scorePieces<PieceRange::White>(board);
+#if STRUCTURE_EVAL
+    return blackScore - whiteScore + structureCache.probe(board).total();
+#else
+    return blackScore - whiteScore;
+#endif
+}
+
+// Black's score for a position on its own, outside a search
+int heuristic(const Board &board) {
+#if NNUE
+    if (nnueLoaded) {
+        NnueAccumulator accumulator;
+        accumulator.refresh(board.pieces);
+        return nnueEvaluate(accumulator);
+    }
+#endif
+    return handcraftedHeuristic(board);
+}
+
+// Black's score for the position the search has reached, which is `board`
+int heuristic(const SearchContext &context, const Board &board) {
+#if NNUE
+    if (nnueLoaded) return nnueEvaluate(context.nnueStack[context.nnuePly]);
+#endif
+    return handcraftedHeuristic(board);
+}
+
+// Plays out up to QS_MAX_PLIES captures from a horizon node. The side to move may always stand pat on the
+// heuristic instead, so only captures that could improve on it are searched, biggest victim and smallest
+// attacker first. Captures never move a car, so no game can end in here. Scores are black's, like alphabeta().
+template<PieceRange range>
+int quiescence(SearchContext &context, const Board &board, int alpha, int beta, int ply = 0) {
+    constexpr bool maximizingPlayer = range == PieceRange::Black;
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+#if STATS
+    context.nodesEvaluated++;
+#endif
+    int bestValue = heuristic(context, board);
+    if (context.shouldStop()) return bestValue;
+
+    if (maximizingPlayer) {
+        if (bestValue >= beta) return bestValue;
+        if (bestValue > alpha) alpha = bestValue;
+    } else {
+        if (bestValue <= alpha) return bestValue;
+        if (bestValue < beta) beta = bestValue;
+    }
+
+    if (ply >= QS_MAX_PLIES) return bestValue;
+
+    auto captures = board.getCaptureMoves<range>();
+    if (captures.moves.empty()) return bestValue;
+
+    auto order = [&board](const Move &move) {
+        return PIECE_VALUES[board.pieceAt(move.toCell)] * 64 - PIECE_VALUES[move.movingPiece];
+    };
+    std::sort(captures.moves.begin(), captures.moves.end(),
+              [&order](const Move &a, const Move &b) { return order(a) > order(b); });
+
+    const int standPat = bestValue;
+    for (const auto &move : captures.moves) {
+        // Victims only get smaller from here, so once one can't reach the window none of the rest can
+        int gain = PIECE_VALUES[board.pieceAt(move.toCell)] + QS_DELTA_MARGIN;
+        if (maximizingPlayer? standPat + gain <= alpha : standPat - gain >= beta) break;
+
+        Board boardCopy(board);
+        boardCopy.performMove<range>(move);
+#if NNUE
+        context.nnuePush(board, move);
+#endif
+        int nodeValue = quiescence<opponent>(context, boardCopy, alpha, beta, ply + 1);
+#if NNUE
+        context.nnuePop();
+#endif
+        if (maximizingPlayer) {
+            if (nodeValue > bestValue) bestValue = nodeValue;
+            if (nodeValue > alpha) alpha = nodeValue;
+        } else {
+            if (nodeValue < bestValue) bestValue = nodeValue;
+            if (nodeValue < beta) beta = nodeValue;
+        }
+        if (alpha >= beta) break;
+    }
+
+    return bestValue;
+}
+
+// Black is always the maximizing player; `range` is the side to move at this node.
+template<PieceRange range>
+int minimax(SearchContext &context, const Board &board, const MoveList &moves, int depth) {
+    constexpr bool maximizingPlayer = range == PieceRange::Black;
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+    if (board.getGameState() == GameState::BlackWins) {
+        return WIN_SCORE + depth;
+    } else if (board.getGameState() == GameState::WhiteWins) {
+        return -WIN_SCORE - depth;
+    } else if (depth == 0 || context.shouldStop()) {
+        return heuristic(context, board);
+    }
+
+    int bestValue = maximizingPlayer? INT_MIN : INT_MAX;
+
+    for (const auto &move : moves.moves) {
+        Board boardCopy(board);
+        boardCopy.performMove<range>(move);
+        auto newMoves = boardCopy.getValidMoves<opponent>();
+#if NNUE
+        context.nnuePush(board, move);
+#endif
+        int nodeValue = minimax<opponent>(context, boardCopy, newMoves, depth - 1);
+#if NNUE
+        context.nnuePop();
+#endif
+        if (maximizingPlayer? nodeValue > bestValue : nodeValue < bestValue) bestValue = nodeValue;
+    }
+
+    return bestValue;
+}
+
+template<PieceRange range>
+int alphabeta(SearchContext &context, const Board &board, int depth, int alpha, int beta) {
+    constexpr bool maximizingPlayer = range == PieceRange::Black;
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+    if (unlikely(board.getGameState() == GameState::BlackWins)) {
+#if STATS
+        context.nodesEvaluated++;
+#endif
+        return WIN_SCORE + depth;
+    } else if (unlikely(board.getGameState() == GameState::WhiteWins)) {
+#if STATS
+        context.nodesEvaluated++;
+#endif
+        return -WIN_SCORE - depth;
+    }
+
+#if RACE_RESOLVER
+    RaceResult race = resolveRace<range>(board);
+    if (race.outcome != RaceOutcome::Unknown) {
+#if STATS
+        context.nodesEvaluated++;
+#endif
+        // Score it as the search would once the race is played out: the winning car arrives after `plies`
+        int plies = race.outcome == RaceOutcome::Won? 2 * race.tempo - 1 : 2 * race.tempo;
+        bool blackWins = (race.outcome == RaceOutcome::Won) == maximizingPlayer;
+        return blackWins? WIN_SCORE + depth - plies : -WIN_SCORE - (depth - plies);
+    }
+#endif
+
+    if (likely(depth == 0) || context.shouldStop()) {
+#if QUIESCENCE
+        if (!context.stopped()) return quiescence<range>(context, board, alpha, beta);
+#endif
+#if STATS
+        context.nodesEvaluated++;
+#endif
+        return heuristic(context, board);
+    }
+
+#if TRANSPOSITION_TABLE
+    TTEntry entry;
+    bool tableHit = probeTable(board, range, entry);
+    if (tableHit && entry.depth >= depth) {
+        int score = scoreFromTable(entry.score, depth);
+        if (entry.bound == Bound::Exact || (entry.bound == Bound::Lower && score >= beta)
+                                        || (entry.bound == Bound::Upper && score <= alpha)) {
+#if STATS
+            context.nodesEvaluated++;
+#endif
+            return score;
+        }
+    }
+    const int alphaOrig = alpha, betaOrig = beta;
+#endif
+
+    int bestValue = maximizingPlayer? INT_MIN : INT_MAX;
+    auto moves = board.getValidMoves<range>();
+#if STATS
+    context.branchNum += moves.moves.size();
+    context.branchDenom++;
+#endif
+
+    std::swap(moves.moves[0], moves.moves[moves.carIdx]);
+#if TRANSPOSITION_TABLE
+    // The best move found for this position last time goes first, ahead of the car
+    if (tableHit) {
+        for (size_t i = 1; i < moves.moves.size(); i++) {
+            if (moves.moves[i] == entry.bestMove) {
+                std::swap(moves.moves[0], moves.moves[i]);
+                break;
+            }
+        }
+    }
+#endif
+
+#if SEARCH_TRACE
+    const int traceAlpha = alpha, traceBeta = beta;
+    const u64 traceNodes = context.nodesEvaluated;
+    u8 cutoff = TRACE_NO_CUTOFF;
+#endif
+
+    Move bestMove = moves.moves[0];
+    for (size_t i = 0; i < moves.moves.size(); i++) {
+        const Move move = moves.moves[i];
+        Board boardCopy(board);
+        boardCopy.performMove<range>(move);
+#if SEARCH_TRACE
+        if (unlikely(context.trace != nullptr)) context.tracePath[context.tracePly(depth) + 1] = move;
+#endif
+#if NNUE
+        context.nnuePush(board, move);
+#endif
+        int nodeValue = alphabeta<opponent>(context, boardCopy, depth - 1, alpha, beta);
+#if NNUE
+        context.nnuePop();
+#endif
+        if (maximizingPlayer) {
+            if (nodeValue > bestValue) {
+                bestValue = nodeValue;
+                bestMove = move;
+            }
+            if (nodeValue > alpha) alpha = nodeValue;
+        } else {
+            if (nodeValue < bestValue) {
+                bestValue = nodeValue;
+                bestMove = move;
+            }
+            if (nodeValue < beta) beta = nodeValue;
+        }
+        if (alpha >= beta) {
+#if SEARCH_TRACE
+            cutoff = static_cast<u8>(std::min<size_t>(i, TRACE_NO_CUTOFF - 1));
+#endif
+            break;
+        }
+    }
+
+#if SEARCH_TRACE
+    if (unlikely(context.trace != nullptr)) {
+        int ply = context.tracePly(depth);
+        TraceRecord record{TraceKind::Node, static_cast<uint8_t>(ply), static_cast<uint8_t>(depth), 0, 0, 0, cutoff, 0,
+                           traceAlpha, traceBeta, bestValue, static_cast<uint32_t>(context.nodesEvaluated - traceNodes)};
+        if (ply > 0) record.setMove(context.tracePath[ply]);
+        context.trace->record(record);
+    }
+#endif
+
+#if TRANSPOSITION_TABLE
+    // A search cut short by the clock or a cancelled ponder has nothing trustworthy to store
+    if (!context.stopped()) {
+        Bound bound = bestValue <= alphaOrig? Bound::Upper : bestValue >= betaOrig? Bound::Lower : Bound::Exact;
+        storeTable(board, range, scoreToTable(bestValue, depth), depth, bound, bestMove);
+    }
+#endif
+    return bestValue;
+}
+
+// Iterative deepening over the root moves of `range` until the context is stopped or `maxDepth` is done.
+// The best move of each iteration is searched first in the next one, so a stopped iteration still has a
+// usable result. Scores are from black's point of view, as everywhere in the search.
+template<PieceRange range = PieceRange::Black>
+SearchResult searchRoot(SearchContext &context, const Board &board, const MoveList &rootMoves, int maxDepth = 64) {
+    constexpr bool maximizingPlayer = range == PieceRange::Black;
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+    SearchResult result;
+    if (rootMoves.moves.empty()) return result;
+
+    std::vector<Move> moves(rootMoves.moves);
+    result.bestMove = moves[0];
+#if NNUE
+    context.nnueRoot(board);
+#endif
+
+#if SEARCH_TRACE
+    if (context.trace) context.trace->record(TraceRecord{TraceKind::Search, 0, 0, 0, 0, 0, TRACE_NO_CUTOFF, 0, 0, 0, 0, 0});
+#endif
+
+    for (int depth = 2; depth <= maxDepth && !context.stopped(); depth++) {
+        if (context.verbose) cout << "Calculating at depth " << depth << '\r' << flush;
+#if SEARCH_TRACE
+        // The root moves are searched with `depth` left, one ply down
+        context.traceRootDepth = depth + 1;
+        const u64 traceNodes = context.nodesEvaluated;
+#endif
+
+        for (size_t i = 1; i < moves.size(); i++) {
+            if (moves[i] == result.bestMove) std::swap(moves[0], moves[i]);
+        }
+
+        Move iterationMove = moves[0];
+        int iterationValue = maximizingPlayer? INT_MIN : INT_MAX;
+        bool searchedAny = false, completed = true;
+        for (const auto &move : moves) {
+            Board boardCopy(board);
+            boardCopy.performMove<range>(move);
+#if SEARCH_TRACE
+            context.tracePath[1] = move;
+#endif
+#if NNUE
+            context.nnuePush(board, move);
+#endif
+#if AB_PRUNING
+            int value = maximizingPlayer? alphabeta<opponent>(context, boardCopy, depth, iterationValue, INT_MAX)
+                                        : alphabeta<opponent>(context, boardCopy, depth, INT_MIN, iterationValue);
+#else
+            auto newMoves = boardCopy.getValidMoves<opponent>();
+            int value = minimax<opponent>(context, boardCopy, newMoves, depth);
+#endif
+#if NNUE
+            context.nnuePop();
+#endif
+            if (context.stopped()) {
+                completed = false;
+                break;
+            }
+            if (!searchedAny || (maximizingPlayer? value > iterationValue : value < iterationValue)) {
+                iterationMove = move;
+                iterationValue = value;
+                searchedAny = true;
+            }
+        }
+
+        if (searchedAny) {
+            result.bestMove = iterationMove;
+            result.score = iterationValue;
+        }
+        if (completed) result.depth = depth;
+
+#if SEARCH_TRACE
+        if (context.trace) {
+            TraceRecord record{TraceKind::Iteration, 0, static_cast<uint8_t>(depth), 0, 0, 0, TRACE_NO_CUTOFF, completed,
+                               INT_MIN, INT_MAX, iterationValue, static_cast<uint32_t>(context.nodesEvaluated - traceNodes)};
+            record.setMove(iterationMove);
+            context.trace->record(record);
+        }
+#endif
+    }
+
+    return result;
+}
+
+// Follows the best moves in the table from the position after `move` for up to `length` moves in all,
+// as long as they stay legal
+inline std::vector<Move> principalVariation(const Board &board, PieceRange range, Move move, size_t length) {
+    std::vector<Move> pv{move};
+    Board current(board);
+    current.performMove(range, move);
+    range = opponentOf(range);
+
+    while (pv.size() < length && current.getGameState() == GameState::IsPlaying) {
+        TTEntry entry;
+        if (!probeTable(current, range, entry)) break;
+
+        auto moves = current.getValidMoves(range);
+        auto next = std::find_if(moves.moves.begin(), moves.moves.end(), [&](const Move &candidate) {
+            return candidate == entry.bestMove && candidate.movingPiece == entry.bestMove.movingPiece;
+        });
+        if (next == moves.moves.end()) break;
+
+        pv.push_back(*next);
+        current.performMove(range, *next);
+        range = opponentOf(range);
+    }
+
+    return pv;
+}
+
+// searchRoot() for the best `lineCount` root moves instead of just the best one. Each iteration searches
+// the root moves in the order of their last scores, and a move only needs an exact score if it beats the
+// worst of the lines found so far; for the rest the window starts at that score, so they fail low about
+// as cheaply as they would next to the single best move. All of it goes through the one table. Lines
+// come back best first, with their variations read from the table.
+template<PieceRange range = PieceRange::Black>
+SearchResult searchMultiPv(SearchContext &context, const Board &board, const MoveList &rootMoves, size_t lineCount,
+                           int maxDepth = 64) {
+    constexpr bool maximizingPlayer = range == PieceRange::Black;
+    constexpr PieceRange opponent = SideTraits<range>::opponent;
+
+    SearchResult result;
+    if (rootMoves.moves.empty()) return result;
+    lineCount = std::max<size_t>(1, std::min(lineCount, rootMoves.moves.size()));
+
+    auto better = [](int a, int b) { return maximizingPlayer? a > b : a < b; };
+    std::vector<PvLine> moves;
+    for (const auto &move : rootMoves.moves) {
+        moves.push_back(PvLine{move, maximizingPlayer? INT_MIN : INT_MAX, {}});
+    }
+    result.bestMove = moves[0].move;
+#if NNUE
+    context.nnueRoot(board);
+#endif
+
+#if SEARCH_TRACE
+    if (context.trace) context.trace->record(TraceRecord{TraceKind::Search, 0, 0, 0, 0, 0, TRACE_NO_CUTOFF, 0, 0, 0, 0, 0});
+#endif
+
+    for (int depth = 2; depth <= maxDepth && !context.stopped(); depth++) {
+        if (context.verbose) cout << "Calculating at depth " << depth << '\r' << flush;
+#if SEARCH_TRACE
+        context.traceRootDepth = depth + 1;
+#endif
+
+        // Searched moves, best first
+        std::vector<PvLine> scored;
+        bool completed = true;
+        for (auto line : moves) {
+            // The score a move has to beat to be one of the lines
+            int threshold = scored.size() >= lineCount? scored[lineCount - 1].score : maximizingPlayer? INT_MIN : INT_MAX;
+
+            Board boardCopy(board);
+            boardCopy.performMove<range>(line.move);
+#if SEARCH_TRACE
+            context.tracePath[1] = line.move;
+#endif
+#if NNUE
+            context.nnuePush(board, line.move);
+#endif
+            if (scored.size() >= lineCount) {
+                // Most moves don't make the lines, which a null window at the threshold shows cheaply
+                line.score = maximizingPlayer? alphabeta<opponent>(context, boardCopy, depth, threshold, threshold + 1)
+                                             : alphabeta<opponent>(context, boardCopy, depth, threshold - 1, threshold);
+            }
+            if (scored.size() < lineCount || better(line.score, threshold)) {
+                line.score = maximizingPlayer? alphabeta<opponent>(context, boardCopy, depth, threshold, INT_MAX)
+                                             : alphabeta<opponent>(context, boardCopy, depth, INT_MIN, threshold);
+            }
+#if NNUE
+            context.nnuePop();
+#endif
+            if (context.stopped()) {
+                completed = false;
+                break;
+            }
+
+            // The re-search can fail low after all, and then its score is only a bound that mustn't push
+            // out the line it was compared against: the move is kept, for ordering, behind the lines
+            auto position = std::upper_bound(scored.begin(), scored.end(), line.score,
+                                             [&](int score, const PvLine &other) { return better(score, other.score); });
+            if (scored.size() >= lineCount && !better(line.score, threshold)) {
+                position = std::max(position, scored.begin() + lineCount);
+            }
+            scored.insert(position, line);
+        }
+
+        // A cut short iteration is only used if there is nothing better
+        if (completed || result.depth == 0) {
+            result.lines.assign(scored.begin(), scored.begin() + std::min(lineCount, scored.size()));
+            for (auto &line : result.lines) line.pv = principalVariation(board, range, line.move, depth + 1);
+            if (!result.lines.empty()) {
+                result.bestMove = result.lines[0].move;
+                result.score = result.lines[0].score;
+            }
+        }
+        if (completed) {
+            result.depth = depth;
+            moves = scored;
+        }
+    }
+
+    return result;
+}
+
+void printSearchStats(const SearchContext &context, std::chrono::steady_clock::time_point startTime) {
+#if STATS
+    auto endTime = std::chrono::steady_clock::now();
+    auto diffTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+    auto diffTimeSc = std::max<double>(diffTimeMs, 1) / 1000.0;
+
+    cout << "Evaluated " << context.nodesEvaluated << " nodes in " << diffTimeMs << "ms." << endl;
+
+    auto nodesInFive = (context.nodesEvaluated / diffTimeSc) * 5;
+    cout << "Nodes in 5: " << nodesInFive << endl;
+
+    auto avgBranches = context.branchDenom > 0? context.branchNum / context.branchDenom : 0;
+    cout << "Avg branches: " << avgBranches << endl;
+#else
+    (void) context;
+    (void) startTime;
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Piece weights for the heuristic in search.h. bench/tune.cpp rewrites this file with weights fitted to
+// self-play results; see there before editing it by hand.
+
+// Indexed by PieceType; cars can't be captured, their worth is in how far along they are
+static const int PIECE_VALUES[11] = {0, 10, 40, 35, 30, 0, 10, 40, 35, 30, 0};
+
+// Per column a car has driven
+static const int CAR_COLUMN_VALUE = 200;
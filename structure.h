@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "bitboard.h"
+#include "board.h"
+#include "side.h"
+
+// Evaluation of the pawn skeleton against the cars' roads. Pawns on the squares a car still has to drive
+// over hold it up, and so can pawns able to push onto one of them before the car gets there. Pawns and
+// cars move far less often than the other pieces, so the result only depends on Board::structureKey and
+// is kept in a cache shared by every search: most leaves find their skeleton there already.
+
+#define STRUCTURE_CACHE_BITS 16
+
+// Penalty for the car's side per pawn on its road, by how many car moves away the square is
+static const int ROAD_BLOCKER[6] = {24, 16, 10, 6, 4, 2};
+
+// Penalty per empty road square that enemy pawns can push onto before the car arrives
+static const int ROAD_CONTESTED[6] = {12, 8, 5, 3, 2, 1};
+
+struct StructureTerms {
+    int blockers = 0;   // Both from black's point of view
+    int race = 0;
+
+    int total() const { return blockers + race; }
+};
+
+// The penalties for `range`'s road, positive numbers
+template<PieceRange range>
+inline StructureTerms roadPenalty(const Board &board) {
+    using Side = SideTraits<range>;
+    using Opponent = SideTraits<Side::opponent>;
+
+    StructureTerms terms;
+    const u64 car = board.pieces[Side::car];
+    int pathIdx = -1;
+    for (int i = 0; i < 6; i++) {
+        if (car == pieceLookupTable[Side::carPath[i]]) pathIdx = i;
+    }
+    if (pathIdx < 0) return terms;
+
+    const u64 pawns = board.pieces[BlackPawn] | board.pieces[WhitePawn];
+    u64 reach = board.pieces[Opponent::pawn];
+    for (int distance = 1; pathIdx + distance <= 6; distance++) {
+        // Enemy pawns get one push per car move, and the car arrives after `distance` of them
+        reach |= Opponent::advance(reach, 8u) & rightColMask;
+
+        const u64 square = pieceLookupTable[Side::carPath[pathIdx + distance]];
+        if (square & pawns) {
+            terms.blockers += ROAD_BLOCKER[distance - 1];
+        } else if (square & reach) {
+            terms.race += ROAD_CONTESTED[distance - 1];
+        }
+    }
+    return terms;
+}
+
+// Black's score for the skeleton, without the cache
+inline StructureTerms evaluateStructure(const Board &board) {
+    StructureTerms black = roadPenalty<PieceRange::Black>(board);
+    StructureTerms white = roadPenalty<PieceRange::White>(board);
+    StructureTerms terms;
+    terms.blockers = white.blockers - black.blockers;
+    terms.race = white.race - black.race;
+    return terms;
+}
+
+// Direct-mapped and lock-free in the same way as the transposition table: each slot holds the key
+// xor'ed with its data, so a slot torn by two threads just fails to match
+class StructureCache {
+public:
+    StructureCache() : slots(static_cast<size_t>(1) << STRUCTURE_CACHE_BITS) {}
+
+    StructureTerms probe(const Board &board) {
+        const u64 key = board.structureKey;
+        Slot &slot = slots[key & (slots.size() - 1)];
+
+        u64 data = slot.data.load(std::memory_order_relaxed);
+        if ((slot.check.load(std::memory_order_relaxed) ^ data) == key && data != 0) {
+            return unpack(data);
+        }
+
+        StructureTerms terms = evaluateStructure(board);
+        data = pack(terms);
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+        slot.data.store(data, std::memory_order_relaxed);
+        return terms;
+    }
+
+    void clear() {
+        for (auto &slot : slots) {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    std::vector<Slot> slots;
+
+    // Both terms as 16 bits each, and a marker bit so that no valid slot holds 0
+    static u64 pack(const StructureTerms &terms) {
+        return static_cast<u64>(static_cast<uint16_t>(terms.blockers))
+             | static_cast<u64>(static_cast<uint16_t>(terms.race)) << 16u
+             | C64(1) << 32u;
+    }
+
+    static StructureTerms unpack(u64 data) {
+        StructureTerms terms;
+        terms.blockers = static_cast<int16_t>(data & 0xFFFFu);
+        terms.race = static_cast<int16_t>((data >> 16u) & 0xFFFFu);
+        return terms;
+    }
+};
+
+static StructureCache structureCache;
@@ -1,52 +1,59 @@
 #pragma once
 
+#ifndef TESTING
 #define TESTING false
+#endif
 #if TESTING
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "move.h"
 #include "board.h"
+#include "dfpn.h"
+#include "race.h"
+#include "structure.h"
+#include "tt.h"
+#include "trace.h"
+#include "rng.h"
+#include "nnue.h"
+#include "playout.h"
+#include "strategy/search.h"
+#if STRATEGY_MCTS
+#include "strategy/mcts.h"
+#endif
+#include "bench/positions.h"
+#include "bench/tuning.h"
 
 #define assertEQ(got, expect) {if((got)!=(expect)){std::cout<<"ERR: expected "<<(expect)<<", got "<<(got)<<" (line "<<__LINE__<<')';return false;}}
 
 Board getEmptyBoard() {
     Board board;
-
-    board.whitePawns     = 0;
-    board.whiteKnights   = 0;
-    board.whiteRooks     = 0;
-    board.whiteBishops   = 0;
-    board.whiteCar       = 0;
-
-    board.blackPawns     = 0;
-    board.blackKnights   = 0;
-    board.blackRooks     = 0;
-    board.blackBishops   = 0;
-    board.blackCar       = 0;
-
-    board.updatePieceAggregates();
-
+    board.clear();
     return board;
 }
 
 bool testPawn() {
     Board board = getEmptyBoard();
-    board.whitePawns.flipBit(3, 3);
-    board.blackPawns.flipBit(2, 1);
-    board.blackCar.flipBit(4, 1);
+    board.flipBit(WhitePawn, 3, 3);
+    board.flipBit(BlackPawn, 2, 1);
+    board.flipBit(BlackCar, 4, 1);
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 1);
 
-    board.performWhiteMove(board.getValidMoves(PieceRange::White, false)[0]);
+    board.performMove<PieceRange::White>(board.getValidMoves(PieceRange::White, false)[0]);
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 2);
 
     board = getEmptyBoard();
-    board.blackPawns.flipBit(3, 3);
-    board.whitePawns.flipBit(2, 5);
-    board.whiteCar.flipBit(4, 5);
+    board.flipBit(BlackPawn, 3, 3);
+    board.flipBit(WhitePawn, 2, 5);
+    board.flipBit(WhiteCar, 4, 5);
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 1);
 
-    board.performBlackMove(board.getValidMoves(PieceRange::Black, false)[0]);
+    board.performMove<PieceRange::Black>(board.getValidMoves(PieceRange::Black, false)[0]);
     assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 2);
 
     return true;
@@ -54,18 +61,18 @@ bool testPawn() {
 
 bool testKnight() {
     Board board = getEmptyBoard();
-    board.whiteKnights.flipBit(3, 3);  // +4 moves
-    board.blackCar.flipBit(4, 1);      // -1 move
-    board.blackPawns.flipBit(2, 1);    // no moves
+    board.flipBit(WhiteKnight, 3, 3);  // +4 moves
+    board.flipBit(BlackCar, 4, 1);      // -1 move
+    board.flipBit(BlackPawn, 2, 1);    // no moves
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 3);
 
     board = getEmptyBoard();
-    board.blackKnights.flipBit(3, 3);  // +4 moves
-    board.whitePawns.flipBit(4, 1);    // +1 move
-    board.whitePawns.flipBit(2, 1);    // +1 move
-    board.whitePawns.flipBit(5, 2);    // +1 move
-    board.whitePawns.flipBit(1, 2);    // +1 move
+    board.flipBit(BlackKnight, 3, 3);  // +4 moves
+    board.flipBit(WhitePawn, 4, 1);    // +1 move
+    board.flipBit(WhitePawn, 2, 1);    // +1 move
+    board.flipBit(WhitePawn, 5, 2);    // +1 move
+    board.flipBit(WhitePawn, 1, 2);    // +1 move
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 8);
 
@@ -74,43 +81,50 @@ bool testKnight() {
 
 bool testRook() {
     Board board = getEmptyBoard();
-    board.whiteRooks.flipBit(2, 4);
-    board.blackRooks.flipBit(2, 1);    // +3 moves
-    board.blackBishops.flipBit(0, 4);  // +1 move
-    board.blackPawns.flipBit(4, 4);    // +1 move
-    board.blackPawns.flipBit(2, 7);    // +1 move
+    board.flipBit(WhiteRook, 2, 4);
+    board.flipBit(BlackRook, 2, 1);    // +3 moves
+    board.flipBit(BlackBishop, 0, 4);  // +1 move
+    board.flipBit(BlackPawn, 4, 4);    // +1 move
+    board.flipBit(BlackPawn, 2, 7);    // +1 move
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 6);
 
     board = getEmptyBoard();
-    board.whiteRooks.flipBit(2, 6);
-    board.whitePawns.flipBit(2, 4);    // +1 move
+    board.flipBit(WhiteRook, 2, 6);
+    board.flipBit(WhitePawn, 2, 4);    // +1 move
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 2);
 
     board = getEmptyBoard();
-    board.blackRooks.flipBit(1, 0);    // +7 moves
-    board.whiteCar.flipBit(1, 6);      // -2 moves
+    board.flipBit(BlackRook, 1, 0);    // +7 moves
+    board.flipBit(WhiteCar, 1, 6);      // -2 moves
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 5);
 
+    // A friendly piece on A1 must not turn an open southward ray into a move onto A1
+    board = getEmptyBoard();
+    board.flipBit(BlackRook, 3, 3);      // +4 moves
+    board.flipBit(BlackPawn, 0, 7);      // no moves
+    board.updatePieceAggregates();
+    assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 4);
+
     return true;
 }
 
 bool testBishop() {
     Board board = getEmptyBoard();
-    board.whiteBishops.flipBit(3, 2);  // +4 moves
-    board.blackPawns.flipBit(4, 1);    // -1 moves
-    board.blackRooks.flipBit(1, 0);    // no moves
-    board.blackKnights.flipBit(5, 4);  // +1 move
+    board.flipBit(WhiteBishop, 3, 2);  // +4 moves
+    board.flipBit(BlackPawn, 4, 1);    // -1 moves
+    board.flipBit(BlackRook, 1, 0);    // no moves
+    board.flipBit(BlackKnight, 5, 4);  // +1 move
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::White, false).size(), 4);
 
     board = getEmptyBoard();
-    board.blackBishops.flipBit(3, 5);  // +4 moves
-    board.whitePawns.flipBit(4, 6);    // -1 move
-    board.whiteRooks.flipBit(1, 7);    // no moves
-    board.whiteKnights.flipBit(5, 3);  // +1 move
+    board.flipBit(BlackBishop, 3, 5);  // +4 moves
+    board.flipBit(WhitePawn, 4, 6);    // -1 move
+    board.flipBit(WhiteRook, 1, 7);    // no moves
+    board.flipBit(WhiteKnight, 5, 3);  // +1 move
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::Black, false).size(), 4);
 
@@ -120,22 +134,819 @@ bool testBishop() {
 bool testCar() {
     // Assert car can run over enemies if there's no other choice
     Board board = getEmptyBoard();
-    board.blackCar.flipBit(0, 0);
-    board.blackRooks.flipBit(2, 5);
-    board.whitePawns.flipBit(1, 1);
+    board.flipBit(BlackCar, 0, 0);
+    board.flipBit(BlackRook, 2, 5);
+    board.flipBit(WhitePawn, 1, 1);
     board.updatePieceAggregates();
     assertEQ(board.getValidMoves(PieceRange::Black).size(), 2);
 
-    board.performBlackMove(board.getValidMoves(PieceRange::Black)[0]);
+    board.performMove<PieceRange::Black>(board.getValidMoves(PieceRange::Black)[0]);
     assertEQ(board.getValidMoves(PieceRange::Black).size(), 1);
 
-    board.performBlackMove(board.getValidMoves(PieceRange::Black)[0]);
-    assertEQ(board.blackCar.isBitSet(0, 0), false);
-    assertEQ(board.blackCar.isBitSet(1, 1), true);
+    board.performMove<PieceRange::Black>(board.getValidMoves(PieceRange::Black)[0]);
+    assertEQ(board.isBitSet(BlackCar, 0, 0), false);
+    assertEQ(board.isBitSet(BlackCar, 1, 1), true);
+
+    return true;
+}
+
+bool testIncrementalState() {
+    // Play out a game and check the mailbox and key against a full rebuild after every move
+    Board board;
+    PieceRange range = PieceRange::White;
+
+    for (int ply = 0; ply < 200 && board.getGameState() == GameState::IsPlaying; ply++) {
+        auto moves = board.getValidMoves(range);
+        board.performMove(range, moves[(ply * 7) % moves.size()]);
+        range = range == PieceRange::White? PieceRange::Black : PieceRange::White;
+
+        Board rebuilt(board);
+        rebuilt.updatePieceAggregates();
+        assertEQ(board.hash(), rebuilt.hash());
+        assertEQ(board.mirrorKey, rebuilt.mirrorKey);
+        assertEQ(board.structureKey, rebuilt.structureKey);
+        assertEQ(board.allPieces, rebuilt.allPieces);
+        for (int square = 0; square < 64; square++) {
+            assertEQ(static_cast<int>(board.pieceAt(square)), static_cast<int>(rebuilt.pieceAt(square)));
+        }
+    }
+
+    return true;
+}
+
+bool testSymmetry() {
+    // The starting position is its own mirror image
+    assertEQ(Board().mirrored().hash(), Board().hash());
+
+    // Along a game, the mirror image has the mirrored moves for the other side and the same canonical key
+    Board board;
+    PieceRange range = PieceRange::White;
+    for (int ply = 0; ply < 200 && board.getGameState() == GameState::IsPlaying; ply++) {
+        Board mirror = board.mirrored();
+        PieceRange mirrorRange = opponentOf(range);
+
+        Board rebuilt(mirror);
+        rebuilt.updatePieceAggregates();
+        assertEQ(mirror.hash(), rebuilt.hash());
+        assertEQ(mirror.mirrorKey, board.hash());
+        assertEQ(mirror.allPieces, rebuilt.allPieces);
+        assertEQ(mirror.mirrored().hash(), board.hash());
+
+        bool mirrored, mirrorMirrored;
+        assertEQ(board.canonicalHash(range, mirrored), mirror.canonicalHash(mirrorRange, mirrorMirrored));
+        assertEQ(mirrored != mirrorMirrored || board.hash(range) == mirror.hash(mirrorRange), true);
+
+        auto moves = board.getValidMoves(range);
+        auto mirrorMoves = mirror.getValidMoves(mirrorRange);
+        assertEQ(mirrorMoves.size(), moves.size());
+        for (auto move : moves.moves) {
+            Move expected = move.mirror();
+            bool found = std::any_of(mirrorMoves.moves.begin(), mirrorMoves.moves.end(), [&](const Move &other) {
+                return other == expected && other.movingPiece == expected.movingPiece;
+            });
+            assertEQ(found, true);
+        }
+
+        board.performMove(range, moves[(ply * 5) % moves.size()]);
+        range = mirrorRange;
+    }
+
+    return true;
+}
+
+bool testMobility() {
+    // Counts must match the generated move lists piece type by piece type over a whole game
+    Board board;
+    PieceRange range = PieceRange::Black;
+
+    for (int ply = 0; ply < 200 && board.getGameState() == GameState::IsPlaying; ply++) {
+        for (PieceRange side : {PieceRange::White, PieceRange::Black}) {
+            auto moves = board.getValidMoves(side);
+            Mobility expected;
+            for (auto move : moves.moves) {
+                switch (move.movingPiece) {
+                    case WhitePawn:   case BlackPawn:   expected.pawn++; break;
+                    case WhiteKnight: case BlackKnight: expected.knight++; break;
+                    case WhiteRook:   case BlackRook:   expected.rook++; break;
+                    case WhiteBishop: case BlackBishop: expected.bishop++; break;
+                    default:                            expected.car++; break;
+                }
+            }
+
+            Mobility counted = board.mobility(side);
+            assertEQ(counted.pawn, expected.pawn);
+            assertEQ(counted.knight, expected.knight);
+            assertEQ(counted.rook, expected.rook);
+            assertEQ(counted.bishop, expected.bishop);
+            assertEQ(counted.car, expected.car);
+            assertEQ(board.countMoves(side, false), static_cast<int>(board.getValidMoves(side, false).size()));
+        }
+
+        auto moves = board.getValidMoves(range);
+        board.performMove(range, moves[(ply * 5) % moves.size()]);
+        range = range == PieceRange::White? PieceRange::Black : PieceRange::White;
+    }
+
+    return true;
+}
+
+bool testCaptures() {
+    // The capture generators must give exactly the moves onto enemy pieces, bar the car's, over a whole game
+    Board board;
+    PieceRange range = PieceRange::Black;
+
+    for (int ply = 0; ply < 200 && board.getGameState() == GameState::IsPlaying; ply++) {
+        for (PieceRange side : {PieceRange::White, PieceRange::Black}) {
+            std::vector<Move> expected;
+            for (auto move : board.getValidMoves(side).moves) {
+                bool isCar = move.movingPiece == BlackCar || move.movingPiece == WhiteCar;
+                if (!isCar && board.pieceAt(move.toCell) != EmptyPiece) expected.push_back(move);
+            }
+
+            auto captures = board.getCaptureMoves(side);
+            assertEQ(captures.moves.size(), expected.size());
+            for (auto move : expected) {
+                assertEQ(std::find(captures.moves.begin(), captures.moves.end(), move) != captures.moves.end(), true);
+            }
+        }
+
+        auto moves = board.getValidMoves(range);
+        board.performMove(range, moves[(ply * 3) % moves.size()]);
+        range = range == PieceRange::White? PieceRange::Black : PieceRange::White;
+    }
+
+    return true;
+}
+
+bool testStructure() {
+    // A car's own pawn two squares up its road holds it up, and an enemy pawn that can push onto the
+    // next square contests it
+    Board board = getEmptyBoard();
+    board.flipBit(WhiteCar, 0, 7);
+    board.flipBit(WhitePawn, 2, 5);
+    board.flipBit(BlackPawn, 1, 5);
+    board.flipBit(BlackCar, 0, 0);
+    board.updatePieceAggregates();
+    StructureTerms terms = evaluateStructure(board);
+    assertEQ(terms.blockers, ROAD_BLOCKER[1]);
+    assertEQ(terms.race, ROAD_CONTESTED[0]);
+
+    // Along a game the cache agrees with a fresh evaluation, and the mirror image scores the other way
+    structureCache.clear();
+    board = Board();
+    PieceRange range = PieceRange::White;
+    for (int ply = 0; ply < 200 && board.getGameState() == GameState::IsPlaying; ply++) {
+        int expected = evaluateStructure(board).total();
+        assertEQ(structureCache.probe(board).total(), expected);
+        assertEQ(structureCache.probe(board).total(), expected);
+        assertEQ(evaluateStructure(board.mirrored()).total(), -expected);
+
+        auto moves = board.getValidMoves(range);
+        board.performMove(range, moves[(ply * 3) % moves.size()]);
+        range = opponentOf(range);
+    }
+
+    return true;
+}
+
+bool testDfpn() {
+    DfpnSolver solver(12);
+
+    // Black's car is one step from the finish with a clear road
+    Board board = getEmptyBoard();
+    board.flipBit(BlackCar, 5, 3);
+    board.flipBit(WhiteCar, 0, 7);
+    board.flipBit(WhitePawn, 5, 6);
+    board.updatePieceAggregates();
+    DfpnResult result = solver.solve(board, PieceRange::Black, 1000);
+    assertEQ(static_cast<int>(result.outcome), static_cast<int>(DfpnOutcome::Win));
+    assertEQ(result.line.size(), 1u);
+    assertEQ(static_cast<int>(result.line[0].toCell), 38);
+
+    // White's car finishes next move and black has nothing that can get in its way
+    board = getEmptyBoard();
+    board.flipBit(WhiteCar, 5, 4);
+    board.flipBit(BlackCar, 0, 0);
+    board.flipBit(BlackPawn, 0, 1);
+    board.updatePieceAggregates();
+    result = solver.solve(board, PieceRange::Black, 1000);
+    assertEQ(static_cast<int>(result.outcome), static_cast<int>(DfpnOutcome::Loss));
+    assertEQ(result.line.size(), 2u);
+
+    return true;
+}
+
+bool testRace() {
+    // Black needs three moves to white's six and nothing can get near the road
+    Board board = getEmptyBoard();
+    board.flipBit(BlackCar, 3, 3);
+    board.flipBit(WhiteCar, 0, 7);
+    board.flipBit(WhitePawn, 0, 6);
+    board.updatePieceAggregates();
+    RaceResult race = resolveRace<PieceRange::Black>(board);
+    assertEQ(static_cast<int>(race.outcome), static_cast<int>(RaceOutcome::Won));
+    assertEQ(race.tempo, 3);
+
+    // The same race seen from white, who is to move but too slow
+    race = resolveRace<PieceRange::White>(board);
+    assertEQ(static_cast<int>(race.outcome), static_cast<int>(RaceOutcome::Lost));
+    assertEQ(race.tempo, 3);
+
+    // A white knight on D4 can jump onto F5 before black's car gets there
+    board.flipBit(WhiteKnight, 3, 4);
+    board.updatePieceAggregates();
+    race = resolveRace<PieceRange::Black>(board);
+    assertEQ(static_cast<int>(race.outcome), static_cast<int>(RaceOutcome::Unknown));
+
+    return true;
+}
+
+bool testTranspositionTable() {
+    TranspositionTable table(4);
+    Move move{BlackRook, 52, 36};
+
+    table.store(0x1234, -250, 6, Bound::Lower, move);
+    TTEntry entry;
+    assertEQ(table.probe(0x1234, entry), true);
+    assertEQ(entry.score, -250);
+    assertEQ(entry.depth, 6);
+    assertEQ(static_cast<int>(entry.bound), static_cast<int>(Bound::Lower));
+    assertEQ(static_cast<int>(entry.bestMove.movingPiece), static_cast<int>(BlackRook));
+    assertEQ(static_cast<int>(entry.bestMove.toCell), 36);
+
+    // A shallower result for another key in the same bucket keeps the deep one
+    table.store(0x1234 + 16, 7, 1, Bound::Exact, move);
+    assertEQ(table.probe(0x1234, entry), true);
+    assertEQ(table.probe(0x1234 + 16, entry), true);
+    assertEQ(entry.score, 7);
+    assertEQ(table.probe(0x5678, entry), false);
+
+    return true;
+}
+
+bool testPersistentTable() {
+    std::string path = "/tmp/phantomracer_test_" + std::to_string(getpid()) + ".tt";
+    Move move{WhiteKnight, 9, 26};
+    const u64 evaluation = evaluationFingerprint();
+
+    {
+        TranspositionTable table(4);
+        assertEQ(table.openFile(path, 6, evaluation), true);
+        assertEQ(table.isPersistent(), true);
+        table.store(0xABCD, 42, 3, Bound::Exact, move);
+    }
+
+    // A second table on the same file sees the entry, and keeps the file's size over the one asked for
+    {
+        TranspositionTable table(4);
+        assertEQ(table.openFile(path, 10, evaluation), true);
+        TTEntry entry;
+        assertEQ(table.probe(0xABCD, entry), true);
+        assertEQ(entry.score, 42);
+        assertEQ(static_cast<int>(entry.bestMove.toCell), 26);
+    }
+
+    // Scores from another evaluation aren't trusted either: a network's differ from the built-in ones
+    {
+        TranspositionTable table(4);
+        assertEQ(table.openFile(path, 6, evaluation + 1), true);
+        TTEntry entry;
+        assertEQ(table.probe(0xABCD, entry), false);
+        table.store(0xABCD, 42, 3, Bound::Exact, move);
+    }
+#if NNUE
+    nnueLoaded = true;
+    assertEQ(evaluationFingerprint() != evaluation, true);
+    nnueLoaded = false;
+#endif
+    assertEQ(evaluationFingerprint(), evaluation);
+
+    // Each process ages the table by its own searches: another one starting searches leaves this one's
+    // deep entry in its slot, but that one's own writes treat the entry as old
+    {
+        TranspositionTable first(4), second(4);
+        assertEQ(first.openFile(path, 6, evaluation), true);
+        assertEQ(second.openFile(path, 6, evaluation), true);
+        first.store(0x40, 5, 8, Bound::Exact, move);
+        for (int i = 0; i < 3; i++) second.newSearch();
+
+        TTEntry entry;
+        first.store(0x80, 6, 1, Bound::Exact, move);
+        assertEQ(first.probe(0x40, entry), true);
+        assertEQ(entry.depth, 8);
+        second.store(0xC0, 7, 1, Bound::Exact, move);
+        assertEQ(second.probe(0xC0, entry), true);
+        assertEQ(first.probe(0x40, entry), false);
+    }
+
+    // A file written by another version is replaced rather than trusted, and never shrunk under a process
+    // that still has it mapped
+    {
+        int fd = open(path.c_str(), O_RDWR);
+        uint32_t version = TT_FILE_VERSION + 1;
+        assertEQ(pwrite(fd, &version, sizeof(version), 8), static_cast<ssize_t>(sizeof(version)));
+        struct stat before{};
+        fstat(fd, &before);
+        void *oldMapping = mmap(nullptr, before.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        assertEQ(oldMapping != MAP_FAILED, true);
+
+        TranspositionTable table(4);
+        assertEQ(table.openFile(path, 4, evaluation), true);
+        TTEntry entry;
+        assertEQ(table.probe(0xABCD, entry), false);
+
+        struct stat after{};
+        fstat(fd, &after);
+        assertEQ(after.st_size, before.st_size);
+        volatile char last = static_cast<char*>(oldMapping)[before.st_size - 1];
+        (void) last;
+        munmap(oldMapping, before.st_size);
+        close(fd);
+
+        assertEQ(stat(path.c_str(), &after), 0);
+        assertEQ(after.st_ino != before.st_ino, true);
+        assertEQ(static_cast<size_t>(after.st_size), table.size() * 16 + 64);
+    }
+
+    unlink(path.c_str());
+    return true;
+}
+
+bool testSearchTrace() {
+    std::string path = "/tmp/phantomracer_test_" + std::to_string(getpid()) + ".trace";
+    Board board;
+    auto moves = board.getValidMoves<PieceRange::Black>();
+
+    TraceWriter writer;
+    assertEQ(writer.open(path), true);
+    transpositionTable.clear();
+    SearchContext context;
+    context.verbose = false;
+    context.trace = &writer;
+    searchRoot<PieceRange::Black>(context, board, moves, 4);
+    writer.close();
+
+    std::vector<TraceRecord> records;
+    assertEQ(readTrace(path, records), true);
+    assertEQ(records.size(), writer.recorded());
+    assertEQ(static_cast<int>(records[0].kind), static_cast<int>(TraceKind::Search));
+
+    // Iterations account for every node, and the root moves' subtrees for no more than their iteration
+    u64 iterationNodes = 0, rootMoveNodes = 0;
+    for (const auto &record : records) {
+        if (record.kind == TraceKind::Iteration) {
+            assertEQ(rootMoveNodes <= record.nodes, true);
+            iterationNodes += record.nodes;
+            rootMoveNodes = 0;
+        } else if (record.kind == TraceKind::Node) {
+            assertEQ(record.ply >= 1 && record.ply + record.depth <= 5, true);
+            if (record.ply == 1) rootMoveNodes += record.nodes;
+        }
+    }
+    assertEQ(iterationNodes, context.nodesEvaluated);
+    assertEQ(static_cast<int>(records.back().kind), static_cast<int>(TraceKind::Iteration));
+    assertEQ(static_cast<int>(records.back().depth), 4);
+
+    unlink(path.c_str());
+    return true;
+}
+
+bool testMultiPv() {
+    // Every line's score must be exact: the same as a full-window search of its move alone
+    for (int index : {0, 9, 30}) {
+        Board board;
+        PieceRange range;
+        assertEQ(parseBoard(BENCH_POSITIONS[index], board, range), true);
+        auto moves = board.getValidMoves(range);
+
+        transpositionTable.clear();
+        SearchContext context;
+        context.verbose = false;
+        SearchResult result = range == PieceRange::Black? searchMultiPv<PieceRange::Black>(context, board, moves, 3, 5)
+                                                         : searchMultiPv<PieceRange::White>(context, board, moves, 3, 5);
+        assertEQ(result.lines.size(), 3u);
+        assertEQ(result.depth, 5);
+
+        for (size_t i = 0; i < result.lines.size(); i++) {
+            const PvLine &line = result.lines[i];
+            assertEQ(!line.pv.empty() && line.pv[0] == line.move, true);
+            if (i > 0) assertEQ(range == PieceRange::Black? line.score <= result.lines[i - 1].score
+                                                           : line.score >= result.lines[i - 1].score, true);
+
+            transpositionTable.clear();
+            SearchContext single;
+            Board boardCopy(board);
+            boardCopy.performMove(range, line.move);
+            int score = range == PieceRange::Black? alphabeta<PieceRange::White>(single, boardCopy, 5, INT_MIN, INT_MAX)
+                                                  : alphabeta<PieceRange::Black>(single, boardCopy, 5, INT_MIN, INT_MAX);
+            assertEQ(line.score, score);
+        }
+    }
+
+    return true;
+}
+
+bool testTuning() {
+    // Under the engine's own weights a corpus position scores exactly what the heuristic gives it
+    std::vector<TuningPosition> positions;
+    for (auto text : BENCH_POSITIONS) {
+        Board board;
+        PieceRange range;
+        assertEQ(parseBoard(text, board, range), true);
+        TuningPosition position = tuningPosition(board, heuristic(board) > 0);
+        assertEQ(tunedScore(position, engineWeights()), static_cast<double>(heuristic(board)));
+        positions.push_back(position);
+    }
+
+    // Starting from flat weights, the fit has to get closer to the results than they are, and the
+    // threads must only change how the work is split
+    TexelTuner tuner(positions, 1), threaded(positions, 3);
+    TuningWeights flat;
+    flat.fill(1);
+    double scale = tuner.fitScale(engineWeights());
+    double flatError = tuner.error(flat, scale);
+    assertEQ(threaded.error(flat, scale), flatError);
+
+    TuningWeights fitted = threaded.fit(flat, scale, 200, 1, false);
+    assertEQ(tuner.error(fitted, scale) < flatError, true);
+
+    // Over several chunks too, down to the last bit of the gradient
+    std::vector<TuningPosition> repeated;
+    while (repeated.size() < 3 * TUNING_CHUNK) repeated.insert(repeated.end(), positions.begin(), positions.end());
+    TuningWeights oneGradient, threeGradient;
+    double oneError = TexelTuner(repeated, 1).errorAndGradient(flat, scale, oneGradient);
+    assertEQ(TexelTuner(repeated, 3).errorAndGradient(flat, scale, threeGradient), oneError);
+    for (int i = 0; i < TUNING_FEATURES; i++) assertEQ(threeGradient[i], oneGradient[i]);
+
+    // A corpus where more pawns always lose would drive the pawn below zero; the fit holds it positive
+    std::vector<TuningPosition> losing(100);
+    for (size_t i = 0; i < losing.size(); i++) {
+        losing[i].features[0] = static_cast<int8_t>(i % 5 + 1);
+        losing[i].blackWon = 0;
+    }
+    TexelTuner losingTuner(losing, 1);
+    TuningWeights held = losingTuner.fit(engineWeights(), 0.01, 200, 1, false);
+    for (double weight : held) assertEQ(weight >= TUNING_MIN_WEIGHT, true);
+    assertEQ(held[0], TUNING_MIN_WEIGHT);
 
     return true;
 }
 
+bool testNnue() {
+    struct Unload { ~Unload() { nnueLoaded = false; } } unload;
+
+    u64 seed = 3;
+    for (auto &column : nnueNetwork.featureWeights) {
+        for (auto &weight : column) weight = static_cast<int16_t>(splitMix64(seed) % 64) - 32;
+    }
+    for (auto &bias : nnueNetwork.featureBiases) bias = static_cast<int16_t>(splitMix64(seed) % 128) - 32;
+    for (auto &weight : nnueNetwork.outputWeights) weight = static_cast<int8_t>(splitMix64(seed) % 256 - 128);
+    nnueNetwork.outputBias = 1234;
+    nnueLoaded = true;
+
+    // The accumulators a search keeps along its line match a rebuild, the vector output matches a plain
+    // one, and evaluating in the search agrees with evaluating from scratch
+    Board board;
+    PieceRange range = PieceRange::White;
+    SearchContext context;
+    context.nnueRoot(board);
+    for (int ply = 0; ply + 1 < NNUE_MAX_PLY && board.getGameState() == GameState::IsPlaying; ply++) {
+        auto moves = board.getValidMoves(range);
+        Move move = moves[(ply * 7) % moves.size()];
+        context.nnuePush(board, move);
+        board.performMove(range, move);
+        range = range == PieceRange::White? PieceRange::Black : PieceRange::White;
+
+        const NnueAccumulator &accumulator = context.nnueStack[context.nnuePly];
+        NnueAccumulator rebuilt;
+        rebuilt.refresh(board.pieces);
+        assertEQ(memcmp(accumulator.values, rebuilt.values, sizeof(rebuilt.values)), 0);
+
+        int sum = nnueNetwork.outputBias;
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            sum += std::min<int>(std::max<int>(accumulator.values[i], 0), 127) * nnueNetwork.outputWeights[i];
+        }
+        assertEQ(nnueEvaluate(accumulator), sum / (1 << NNUE_OUTPUT_SHIFT));
+        assertEQ(heuristic(context, board), heuristic(board));
+    }
+    assertEQ(context.nnuePly > 0, true);
+
+    // The random network scores positions and their mirror images differently, so the table must not hand
+    // one's entry to the other while it is loaded. Without it, they share entries as before.
+    transpositionTable.clear();
+    board = Board();
+    range = PieceRange::White;
+    int asymmetric = 0, shared = 0;
+    for (int ply = 0; ply < 40 && board.getGameState() == GameState::IsPlaying; ply++) {
+        Board mirror = board.mirrored();
+        PieceRange mirrorRange = opponentOf(range);
+        if (mirror.hash(mirrorRange) != board.hash(range)) {
+            if (heuristic(mirror) != -heuristic(board)) asymmetric++;
+            TTEntry entry;
+            storeTable(mirror, mirrorRange, heuristic(mirror), 1, Bound::Exact, Move());
+            assertEQ(probeTable(board, range, entry), false);
+
+            nnueLoaded = false;
+            storeTable(mirror, mirrorRange, 1, 1, Bound::Exact, Move());
+            if (probeTable(board, range, entry)) shared++;
+            nnueLoaded = true;
+        }
+
+        // Nor are the built-in evaluation's entries the network's, even for the position itself
+        TTEntry entry;
+        transpositionTable.clear();
+        nnueLoaded = false;
+        storeTable(board, range, 1, 1, Bound::Exact, Move());
+        assertEQ(probeTable(board, range, entry), true);
+        nnueLoaded = true;
+        assertEQ(probeTable(board, range, entry), false);
+        storeTable(board, range, 2, 1, Bound::Exact, Move());
+        nnueLoaded = false;
+        assertEQ(probeTable(board, range, entry) && entry.score == 1, true);
+        nnueLoaded = true;
+        auto moves = board.getValidMoves(range);
+        board.performMove(range, moves[(ply * 5) % moves.size()]);
+        range = opponentOf(range);
+    }
+    assertEQ(asymmetric > 0, true);
+    assertEQ(shared > 0, true);
+    transpositionTable.clear();
+
+    // A saved network loads back, and a file for another network size is refused
+    std::string path = "/tmp/phantomracer_test_" + std::to_string(getpid()) + ".nnue";
+    auto save = [&](uint32_t hidden) {
+        std::ofstream file(path, std::ios::binary);
+        uint32_t version = NNUE_FILE_VERSION;
+        file.write("PRNNUE\0\0", 8);
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        file.write(reinterpret_cast<const char*>(&hidden), sizeof(hidden));
+        file.write(reinterpret_cast<const char*>(nnueNetwork.featureWeights), sizeof(nnueNetwork.featureWeights));
+        file.write(reinterpret_cast<const char*>(nnueNetwork.featureBiases), sizeof(nnueNetwork.featureBiases));
+        file.write(reinterpret_cast<const char*>(nnueNetwork.outputWeights), sizeof(nnueNetwork.outputWeights));
+        file.write(reinterpret_cast<const char*>(&nnueNetwork.outputBias), sizeof(nnueNetwork.outputBias));
+    };
+
+    save(NNUE_HIDDEN);
+    int expected = heuristic(board);
+    nnueNetwork.outputBias = 0;
+    assertEQ(loadNnue(path), true);
+    assertEQ(heuristic(board), expected);
+
+    save(NNUE_HIDDEN * 2);
+    assertEQ(loadNnue(path), false);
+    assertEQ(nnueNetwork.outputBias, 1234);
+
+    unlink(path.c_str());
+    return true;
+}
+
+bool testRandom() {
+    // The same seed gives the same sequence
+    Rng a(42), b(42), c(43);
+    for (int i = 0; i < 100; i++) {
+        u64 value = a.next();
+        assertEQ(b.next(), value);
+        assertEQ(c.next() != value, true);
+    }
+
+    // Bounded draws stay in range and come out evenly, here within 10% of the expected count
+    const uint32_t bound = 7, draws = 70000;
+    u64 counts[bound] = {};
+    for (uint32_t i = 0; i < draws; i++) {
+        uint32_t value = a.below(bound);
+        assertEQ(value < bound, true);
+        counts[value]++;
+    }
+    for (u64 count : counts) {
+        assertEQ(count > draws / bound * 9 / 10 && count < draws / bound * 11 / 10, true);
+    }
+    assertEQ(a.below(1), 0u);
+
+    // A shuffle is a permutation
+    std::vector<int> values = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    a.shuffle(values.begin(), values.end());
+    std::vector<int> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    for (int i = 0; i < 10; i++) assertEQ(sorted[i], i);
+
+    // Reseeding restarts the calling thread's sequence
+    seedRandom(7);
+    u64 first = threadRng().next();
+    seedRandom(7);
+    assertEQ(threadRng().next(), first);
+    assertEQ(randomSeed(), 7u);
+
+    return true;
+}
+
+bool testSlidingAttacks4() {
+    u64 seed = 1;
+    for (int i = 0; i < 1000; i++) {
+        u64 sliders = splitMix64(seed) & splitMix64(seed) & rightColMask;
+        u64 empty = ~(splitMix64(seed) & splitMix64(seed)) & ~sliders;
+
+        u64 attacks[4];
+        slidingAttacks4<North, South, East, West>(sliders, empty, attacks);
+        assertEQ(attacks[0], slidingAttacks<North>(sliders, empty));
+        assertEQ(attacks[1], slidingAttacks<South>(sliders, empty));
+        assertEQ(attacks[2], slidingAttacks<East>(sliders, empty));
+        assertEQ(attacks[3], slidingAttacks<West>(sliders, empty));
+
+        slidingAttacks4<NorthEast, NorthWest, SouthEast, SouthWest>(sliders, empty, attacks);
+        assertEQ(attacks[0], slidingAttacks<NorthEast>(sliders, empty));
+        assertEQ(attacks[1], slidingAttacks<NorthWest>(sliders, empty));
+        assertEQ(attacks[2], slidingAttacks<SouthEast>(sliders, empty));
+        assertEQ(attacks[3], slidingAttacks<SouthWest>(sliders, empty));
+    }
+
+    return true;
+}
+
+bool testPlayoutKernel() {
+    // Every lane's move must be one the move generator allows
+    PlayoutKernel kernel(7);
+    kernel.load(Board(), PieceRange::White);
+
+    for (int ply = 0; ply < 60; ply++) {
+        Board before[PlayoutKernel::LANES];
+        for (int lane = 0; lane < PlayoutKernel::LANES; lane++) {
+            before[lane] = kernel.laneBoard(lane);
+        }
+
+        PieceRange range = kernel.sideToMove();
+        kernel.step();
+
+        for (int lane = 0; lane < PlayoutKernel::LANES; lane++) {
+            Board after = kernel.laneBoard(lane);
+            if (before[lane].getGameState() != GameState::IsPlaying) {
+                assertEQ(after.key, before[lane].key);
+                continue;
+            }
+
+            bool legal = false;
+            for (auto move : before[lane].getValidMoves(range).moves) {
+                Board expected(before[lane]);
+                expected.performMove(range, move);
+                legal |= expected.key == after.key && expected.allPieces == after.allPieces;
+            }
+            assertEQ(legal, true);
+        }
+    }
+
+    // A car one step from the finish with nothing else to move wins every playout
+    Board board = getEmptyBoard();
+    board.pieces[BlackCar] = pieceLookupTable[37];
+    board.pieces[WhiteCar] = pieceLookupTable[0];
+    board.updatePieceAggregates();
+    kernel.recordMoves = true;
+    PlayoutResult result = kernel.run(board, PieceRange::Black);
+    assertEQ(result.blackWins, static_cast<u32>(PlayoutKernel::LANES));
+    assertEQ(result.whiteWins, 0u);
+    assertEQ(kernel.movesPlayed(0).size(), 1u);
+    assertEQ(kernel.movesPlayed(0)[0] == (Move{BlackCar, 37, 38}), true);
+
+    return true;
+}
+
+#if STRATEGY_MCTS
+bool testMctsGraph() {
+    // Two white moves played in either order around the same black reply reach one shared node
+    seedRandom(3);
+    Board start;
+    MctsGraph graph(start, PieceRange::White);
+    auto whiteMoves = start.getValidMoves(PieceRange::White).moves;
+    Board first(start), second(start);
+    first.performMove(PieceRange::White, whiteMoves[0]);
+    Move reply = first.getValidMoves(PieceRange::Black).moves[0];
+    first.performMove(PieceRange::Black, reply);
+    first.performMove(PieceRange::White, whiteMoves.back());
+    second.performMove(PieceRange::White, whiteMoves.back());
+    second.performMove(PieceRange::Black, reply);
+    second.performMove(PieceRange::White, whiteMoves[0]);
+    assertEQ(first.allPieces, second.allPieces);
+
+    Node* shared = graph.nodeFor(first, PieceRange::Black);
+    assertEQ(graph.nodeFor(second, PieceRange::Black) == shared, true);
+    assertEQ(graph.transpositions, 1u);
+
+    // After N simulations every playout went through the root, and every other node was entered exactly
+    // as often as the edges into it were taken, however many parents it has
+    Board board;
+    PieceRange range;
+    assertEQ(parseBoard(BENCH_POSITIONS[20], board, range), true);
+    MctsGraph search(board, range);
+    MctsSettings settings;
+    settings.leafDepth = 0;
+    settings.verbose = false;
+    SearchContext context;
+    std::vector<PathStep> path;
+    const u32 simulations = 2000;
+    for (u32 i = 0; i < simulations; i++) {
+        search.select(settings.exploration, path);
+        search.backpropagation(path, path.back().node->defaultPolicy(context, settings));
+    }
+    assertEQ(search.root->totalCount, simulations * PlayoutKernel::LANES);
+    assertEQ(search.root->edgeTotal, simulations * PlayoutKernel::LANES);
+
+    std::unordered_map<Node*, u32> incoming;
+    std::unordered_map<Node*, int> parents;
+    std::vector<Node*> pending{search.root};
+    std::unordered_set<Node*> seen{search.root};
+    while (!pending.empty()) {
+        Node* node = pending.back();
+        pending.pop_back();
+        u32 edgeSum = 0;
+        for (size_t i = 0; i < node->moves.size(); i++) {
+            edgeSum += node->edgeVisits[i];
+            Node* child = node->children[i];
+            if (!child) continue;
+            incoming[child] += node->edgeVisits[i];
+            if (node->edgeVisits[i] > 0) parents[child]++;
+            if (seen.insert(child).second) pending.push_back(child);
+        }
+        assertEQ(node->edgeTotal, edgeSum);
+    }
+
+    int sharedNodes = 0;
+    for (Node* node : seen) {
+        if (node == search.root) continue;
+        assertEQ(node->totalCount, incoming[node]);
+        sharedNodes += parents[node] > 1;
+    }
+    assertEQ(search.transpositions > 0 && sharedNodes > 0, true);
+
+    // A budget spent before the first simulation still gives a legal move, and a report without a win rate
+    MctsSettings spent;
+    spent.budget = std::chrono::milliseconds(0);
+    Board initial;
+    auto initialMoves = initial.getValidMoves(PieceRange::White).moves;
+    Move move = searchMcts(initial, PieceRange::White, spent);
+    assertEQ(std::find(initialMoves.begin(), initialMoves.end(), move) != initialMoves.end(), true);
+
+    return true;
+}
+#endif
+
+#if STRATEGY_MCTS && RAVE
+bool testAmafCredit() {
+    // A path of three nodes, white, black and white to move, ending in a seeded playout
+    seedRandom(5);
+    Board board;
+    Node root(board, PieceRange::White);
+    board.performMove(PieceRange::White, root.moves[1]);
+    Node middle(board, PieceRange::Black);
+    board.performMove(PieceRange::Black, middle.moves[2]);
+    Node leaf(board, PieceRange::White);
+    std::vector<PathStep> path{{&root, 1}, {&middle, 2}, {&leaf, -1}};
+
+    PlayoutKernel kernel(11);
+    kernel.recordMoves = true;
+    kernel.run(leaf.board, leaf.pieceRange);
+    const std::vector<Move> &playout = kernel.movesPlayed(0);
+    assertEQ(playout.empty(), false);
+    MctsGraph::updateAmaf(path, playout, kernel.laneOutcome(0));
+
+    // A node's move gets credit exactly when it was played from that node on, down the path or in the
+    // playout, and the credit is a win when the node's side to move won
+    auto same = [](const Move &a, const Move &b) { return a == b && a.movingPiece == b.movingPiece; };
+    for (size_t i = 0; i < path.size(); i++) {
+        Node* node = path[i].node;
+        bool won = (kernel.laneOutcome(0) == GameState::BlackWins) == (node->pieceRange == PieceRange::Black);
+        for (size_t j = 0; j < node->moves.size(); j++) {
+            const Move &move = node->moves[j];
+            bool later = std::any_of(playout.begin(), playout.end(), [&](const Move &played) { return same(played, move); });
+            for (size_t k = i; k + 1 < path.size(); k++) later |= same(path[k].node->moves[path[k].moveIndex], move);
+
+            assertEQ(node->amafTotals[j], later? 1u : 0u);
+            assertEQ(node->amafWins[j], later && won? 1u : 0u);
+            if (later) assertEQ(node->pieceRange == PieceRange::Black, move.movingPiece <= BlackCar);
+        }
+    }
+
+    // Every step's own move and the playout's first one are among those
+    assertEQ(root.amafTotals[1], 1u);
+    assertEQ(middle.amafTotals[2], 1u);
+    assertEQ(std::accumulate(leaf.amafTotals.begin(), leaf.amafTotals.end(), 0u) > 0, true);
+    return true;
+}
+
+bool testRaveSearch() {
+    // A search with the default settings, hybrid leaves included, still plays out its leaves for RAVE:
+    // every lane through a root edge credits at least that edge's move
+    MctsSettings settings;
+    settings.budget = std::chrono::milliseconds(200);
+    settings.verbose = false;
+    MctsGraph graph(Board(), PieceRange::White);
+    searchMcts(graph, settings);
+
+    const Node* root = graph.root;
+    assertEQ(root->edgeTotal > 0, true);
+    assertEQ(std::accumulate(root->amafTotals.begin(), root->amafTotals.end(), 0u) >= root->edgeTotal, true);
+    for (size_t i = 0; i < root->moves.size(); i++) assertEQ(root->amafTotals[i] >= root->edgeVisits[i], true);
+    return true;
+}
+#endif
+
 bool testRaycasting() {
     assertEQ(rayLookupTable[North][20], C64(0b1000000010000000100000001000000010000000000000000000000000000));
     assertEQ(rayLookupTable[NorthWest][20], C64(0b1000000100000010000001000000000000000000000000000));
@@ -158,16 +969,18 @@ bool testLookup() {
 }
 
 static int testCount = 0;
+static int failCount = 0;
 
 void test(const std::string& name, bool (*f)()) {
     testCount++;
 
     if (!f()) {
+        failCount++;
         std::cout <<" (in test: " << name << ")" << std::endl;
     }
 }
 
-void testingMain() {
+int testingMain() {
     initAll();
 
     test("pawn", testPawn);
@@ -175,11 +988,35 @@ void testingMain() {
     test("rook", testRook);
     test("bishop", testBishop);
     test("car", testCar);
+    test("incremental state", testIncrementalState);
+    test("symmetry", testSymmetry);
+    test("mobility", testMobility);
+    test("captures", testCaptures);
+    test("structure", testStructure);
+    test("dfpn", testDfpn);
+    test("race", testRace);
+    test("transposition table", testTranspositionTable);
+    test("persistent table", testPersistentTable);
+    test("search trace", testSearchTrace);
+    test("multi-PV", testMultiPv);
+    test("tuning", testTuning);
+    test("neural evaluation", testNnue);
 
+    test("random numbers", testRandom);
+    test("set-wise attacks", testSlidingAttacks4);
+    test("playout kernel", testPlayoutKernel);
+#if STRATEGY_MCTS
+    test("MCTS graph", testMctsGraph);
+#endif
+#if STRATEGY_MCTS && RAVE
+    test("AMAF credit", testAmafCredit);
+    test("RAVE search", testRaveSearch);
+#endif
     test("raycasting", testRaycasting);
     test("lookup tables", testLookup);
 
     std::cout << "All " << testCount << " tests complete." << std::endl;
+    return failCount;
 }
 
 #endif
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "move.h"
+
+// Search trace for offline profiling: a search given a TraceWriter appends a fixed-size record for every
+// node that searched its moves, when it returns, so a node's record follows those of its children. The
+// records go into a ring of TRACE_RING_RECORDS; with a file open the ring is written out each time it
+// fills, otherwise it just keeps the latest records. Either way tracing costs a bounded amount of memory
+// and one write() per ring, and nothing at all for searches without a writer.
+// bench/trace.cpp summarises a trace file.
+//
+// The file is, in little-endian order: char magic[8] "PRTRACE", u32 version, u32 record size, records.
+
+#define TRACE_FILE_VERSION 1
+#define TRACE_RING_RECORDS (1u << 16u)
+
+// Marks a node that searched all its moves without a cutoff
+#define TRACE_NO_CUTOFF 0xFF
+
+enum class TraceKind : uint8_t {
+    Search,         // searchRoot() started on a new position
+    Iteration,      // An iteration of searchRoot() finished; depth is its depth
+    Node,           // An alphabeta() node; move is the one that led to it
+    Simulation,     // An MCTS simulation; ply is the length of its path, move the root move it took
+};
+
+struct TraceRecord {
+    TraceKind kind;
+    uint8_t ply;            // Distance from the root, which is ply 0
+    uint8_t depth;          // Depth left to search at the node
+    uint8_t piece;
+    uint8_t from;
+    uint8_t to;
+    uint8_t cutoff;         // Index of the move that caused a cutoff, or TRACE_NO_CUTOFF
+    uint8_t completed;      // Whether an iteration searched every root move
+    int32_t alpha;          // The window the node was searched with
+    int32_t beta;
+    int32_t score;          // Black's, as everywhere in the search; MCTS gives black wins in thousandths
+    uint32_t nodes;         // Nodes evaluated in the subtree, or by the simulation's leaf search
+
+    Move move() const {
+        return Move{static_cast<PieceType>(piece), from, to};
+    }
+
+    void setMove(const Move &move) {
+        piece = static_cast<uint8_t>(move.movingPiece);
+        from = static_cast<uint8_t>(move.fromCell);
+        to = static_cast<uint8_t>(move.toCell);
+    }
+};
+
+static_assert(sizeof(TraceRecord) == 24, "The trace file layout must not change silently");
+
+static constexpr const char TRACE_MAGIC[8] = {'P', 'R', 'T', 'R', 'A', 'C', 'E', '\0'};
+
+class TraceWriter {
+public:
+    TraceWriter() : ring(TRACE_RING_RECORDS) {}
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    ~TraceWriter() {
+        close();
+    }
+
+    // Streams every record from now on into `path`, which is replaced
+    bool open(const std::string &path) {
+        close();
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+
+        char header[16];
+        uint32_t version = TRACE_FILE_VERSION, recordSize = sizeof(TraceRecord);
+        memcpy(header, TRACE_MAGIC, 8);
+        memcpy(header + 8, &version, 4);
+        memcpy(header + 12, &recordSize, 4);
+        if (write(fd, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+            close();
+            return false;
+        }
+        head = 0;
+        return true;
+    }
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    // Writes out what the ring holds and closes the file
+    void close() {
+        if (fd < 0) return;
+        writeRecords(head % TRACE_RING_RECORDS);
+        ::close(fd);
+        fd = -1;
+    }
+
+    void record(const TraceRecord &record) {
+        ring[head % TRACE_RING_RECORDS] = record;
+        head++;
+        if (fd >= 0 && head % TRACE_RING_RECORDS == 0) writeRecords(TRACE_RING_RECORDS);
+    }
+
+    u64 recorded() const {
+        return head;
+    }
+
+    // The records still in the ring, oldest first
+    std::vector<TraceRecord> latest() const {
+        std::vector<TraceRecord> records;
+        u64 first = fd >= 0? head - head % TRACE_RING_RECORDS : head > TRACE_RING_RECORDS? head - TRACE_RING_RECORDS : 0;
+        for (u64 i = first; i < head; i++) records.push_back(ring[i % TRACE_RING_RECORDS]);
+        return records;
+    }
+
+private:
+    std::vector<TraceRecord> ring;
+    u64 head = 0;
+    int fd = -1;
+
+    void writeRecords(size_t count) {
+        // A trace that can't be written is lost, but the search must go on regardless
+        if (write(fd, ring.data(), count * sizeof(TraceRecord)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// Reads a whole trace file, as written by TraceWriter
+bool readTrace(const std::string &path, std::vector<TraceRecord> &records) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    char header[16];
+    uint32_t version = 0, recordSize = 0;
+    bool valid = read(fd, header, sizeof(header)) == static_cast<ssize_t>(sizeof(header))
+              && !memcmp(header, TRACE_MAGIC, 8);
+    if (valid) {
+        memcpy(&version, header + 8, 4);
+        memcpy(&recordSize, header + 12, 4);
+        valid = version == TRACE_FILE_VERSION && recordSize == sizeof(TraceRecord);
+    }
+
+    records.clear();
+    TraceRecord buffer[1024];
+    ssize_t bytes;
+    while (valid && (bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+        records.insert(records.end(), buffer, buffer + bytes / sizeof(TraceRecord));
+    }
+
+    ::close(fd);
+    return valid;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "bitboard.h"
+#include "move.h"
+
+// Transposition table for the alphabeta search, shared between the main search and the ponder thread.
+// Each slot holds the key xor'ed with its data, so a slot torn by two threads writing at once simply
+// fails to match on the next probe instead of handing back another position's data. No locks needed.
+//
+// Slots come in pairs: the first keeps the deepest result that mapped to it, the second the newest, so
+// the entries near the root survive the flood of shallow ones written below them. Entries left over from
+// an earlier search give up the deep slot to anything new.
+//
+// The slots normally live on the heap, but openFile() can move them into a memory-mapped file instead.
+// Any number of engine processes can then share the table and it survives restarts: writes stay
+// lock-free per slot, and the file lock is only held while the header is checked or written. Searches
+// are counted per process, so one process starting a search never ages another's entries; to a process,
+// though, every entry it didn't write in its current search counts as old, so deep results only hold
+// their slot against the process that found them.
+
+#define TT_FILE_VERSION 3
+
+enum class Bound : u8 {
+    None,
+    Exact,
+    Lower,      // The score is at least this (a cutoff happened)
+    Upper,      // The score is at most this (no move raised alpha)
+};
+
+struct TTEntry {
+    int score = 0;
+    int depth = 0;
+    Bound bound = Bound::None;
+    Move bestMove{EmptyPiece, 0, 0};
+};
+
+class TranspositionTable {
+public:
+    explicit TranspositionTable(unsigned tableBits = 20) {
+        useHeap(tableBits);
+    }
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    ~TranspositionTable() {
+        unmap();
+    }
+
+    // Switches to a table stored in `path`, creating or resetting it as needed. `evalFingerprint` stands
+    // for whatever the stored scores depend on beyond the position, and a file written under another one
+    // is reset. A file that is already valid keeps its own size, since other processes may have it mapped.
+    // Must be called while no search is running; on failure the table stays as it was.
+    bool openFile(const std::string &path, unsigned tableBits, u64 evalFingerprint) {
+        int fd;
+        struct stat info{};
+        while (true) {
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0) return false;
+            if (flock(fd, LOCK_EX) < 0) {
+                close(fd);
+                return false;
+            }
+
+            // Another process may have replaced the file while this one waited for the lock
+            struct stat current{};
+            fstat(fd, &info);
+            if (stat(path.c_str(), &current) == 0 && current.st_dev == info.st_dev && current.st_ino == info.st_ino) break;
+            flock(fd, LOCK_UN);
+            close(fd);
+        }
+
+        FileHeader header{};
+        bool valid = static_cast<size_t>(info.st_size) >= sizeof(FileHeader)
+                  && pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+                  && !memcmp(header.magic, FILE_MAGIC, sizeof(header.magic))
+                  && header.version == TT_FILE_VERSION
+                  && header.keyFingerprint == zobristFingerprint()
+                  && header.evalFingerprint == evalFingerprint
+                  && header.tableBits >= 1 && header.tableBits < 40
+                  && static_cast<size_t>(info.st_size) == fileSize(header.tableBits);
+
+        if (!valid) {
+            // Entries written by another version, under other keys or by another evaluation can't be
+            // trusted: start afresh
+            header = FileHeader{};
+            memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+            header.version = TT_FILE_VERSION;
+            header.tableBits = tableBits;
+            header.keyFingerprint = zobristFingerprint();
+            header.evalFingerprint = evalFingerprint;
+
+            // A file with contents may still be mapped by a process that trusts it, which would fault on
+            // any page a shrink cut off. The new table is built beside it and renamed over it instead, so
+            // such processes keep the old file to themselves until they close it.
+            int newFd = info.st_size == 0? fd : createReplacement(path, tableBits);
+            if (newFd < 0 || (newFd == fd && ftruncate(fd, static_cast<off_t>(fileSize(tableBits))) < 0)
+                || pwrite(newFd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+                || (newFd != fd && rename(replacementPath(path).c_str(), path.c_str()) < 0)) {
+                if (newFd >= 0 && newFd != fd) {
+                    unlink(replacementPath(path).c_str());
+                    close(newFd);
+                }
+                flock(fd, LOCK_UN);
+                close(fd);
+                return false;
+            }
+            if (newFd != fd) {
+                flock(fd, LOCK_UN);
+                close(fd);
+                fd = newFd;
+            }
+        }
+
+        size_t size = fileSize(header.tableBits);
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (memory == MAP_FAILED) return false;
+
+        unmap();
+        heapSlots.clear();
+        heapSlots.shrink_to_fit();
+
+        mapping = memory;
+        mappingSize = size;
+        setSlots(reinterpret_cast<Slot*>(static_cast<char*>(memory) + sizeof(FileHeader)), header.tableBits);
+        return true;
+    }
+
+    bool isPersistent() const {
+        return mapping != nullptr;
+    }
+
+    size_t size() const {
+        return slotCount;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < slotCount; i++) {
+            slots[i].check.store(0, std::memory_order_relaxed);
+            slots[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Called before each new search so that older entries can be recognised
+    void newSearch() {
+        generation.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool probe(u64 key, TTEntry &entry) const {
+        const Slot *bucket = &slots[key & mask];
+        for (int i = 0; i < 2; i++) {
+            u64 data = bucket[i].data.load(std::memory_order_relaxed);
+            if ((bucket[i].check.load(std::memory_order_relaxed) ^ data) == key && data != 0) {
+                entry = unpack(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(u64 key, int score, int depth, Bound bound, Move bestMove) {
+        Slot *bucket = &slots[key & mask];
+        u64 data = pack(score, depth, bound, bestMove);
+
+        u64 deepData = bucket[0].data.load(std::memory_order_relaxed);
+        bool sameKey = (bucket[0].check.load(std::memory_order_relaxed) ^ deepData) == key;
+        bool stale = (deepData >> 58u) != currentGeneration();
+        Slot &slot = sameKey || stale || depth >= unpack(deepData).depth? bucket[0] : bucket[1];
+
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+        slot.data.store(data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    // Fixed-width fields only, since the layout is shared by every process using the file
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t tableBits;
+        uint64_t keyFingerprint;
+        uint64_t evalFingerprint;
+        uint64_t reserved[4];
+    };
+
+    static constexpr const char FILE_MAGIC[8] = {'P', 'R', 'A', 'C', 'E', 'T', 'T', '\0'};
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Slots shared between processes must be lock-free");
+    static_assert(sizeof(Slot) == 16 && sizeof(FileHeader) == 64, "The table file layout must not change silently");
+
+    Slot *slots = nullptr;
+    size_t slotCount = 0;
+    size_t mask = 0;
+
+    std::vector<Slot> heapSlots;
+    std::atomic<uint64_t> generation{0};    // Searches started, of which the low 6 bits tag the entries
+
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    static size_t fileSize(unsigned tableBits) {
+        return sizeof(FileHeader) + (static_cast<size_t>(1) << tableBits) * sizeof(Slot);
+    }
+
+    u64 currentGeneration() const {
+        return generation.load(std::memory_order_relaxed) & 0x3Fu;
+    }
+
+    static std::string replacementPath(const std::string &path) {
+        return path + ".new." + std::to_string(getpid());
+    }
+
+    // An empty table file of the given size at replacementPath(), opened and locked
+    static int createReplacement(const std::string &path, unsigned tableBits) {
+        int fd = open(replacementPath(path).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        if (flock(fd, LOCK_EX) < 0 || ftruncate(fd, static_cast<off_t>(fileSize(tableBits))) < 0) {
+            unlink(replacementPath(path).c_str());
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void setSlots(Slot *newSlots, unsigned tableBits) {
+        slots = newSlots;
+        slotCount = static_cast<size_t>(1) << tableBits;
+        mask = (slotCount - 1) & ~static_cast<size_t>(1);
+    }
+
+    void useHeap(unsigned tableBits) {
+        heapSlots = std::vector<Slot>(static_cast<size_t>(1) << tableBits);
+        setSlots(heapSlots.data(), tableBits);
+    }
+
+    void unmap() {
+        if (mapping) munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+    // Bits 0-31 score, 32-39 depth, 40-41 bound, 42-47 from, 48-53 to, 54-57 moving piece, 58-63 generation
+    u64 pack(int score, int depth, Bound bound, Move move) const {
+        return static_cast<u64>(static_cast<uint32_t>(score))
+             | static_cast<u64>(depth & 0xFF) << 32u
+             | static_cast<u64>(bound) << 40u
+             | static_cast<u64>(move.fromCell & 0x3F) << 42u
+             | static_cast<u64>(move.toCell & 0x3F) << 48u
+             | static_cast<u64>(move.movingPiece & 0xF) << 54u
+             | currentGeneration() << 58u;
+    }
+
+    static TTEntry unpack(u64 data) {
+        TTEntry entry;
+        entry.score = static_cast<int32_t>(static_cast<uint32_t>(data & 0xFFFFFFFFu));
+        entry.depth = static_cast<int>((data >> 32u) & 0xFF);
+        entry.bound = static_cast<Bound>((data >> 40u) & 0x3);
+        entry.bestMove = Move{static_cast<PieceType>((data >> 54u) & 0xF),
+                              static_cast<u8>((data >> 42u) & 0x3F), static_cast<u8>((data >> 48u) & 0x3F)};
+        return entry;
+    }
+};
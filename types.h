@@ -29,3 +29,8 @@ enum PieceType : u8 {
     WhiteBishop = 9,
     WhiteCar    = 10,
 };
+
+// The same piece for the other colour
+constexpr PieceType mirrorPiece(PieceType piece) {
+    return piece == EmptyPiece? EmptyPiece : static_cast<PieceType>(piece <= BlackCar? piece + 5 : piece - 5);
+}